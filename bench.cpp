@@ -0,0 +1,1387 @@
+/**
+ * @file bench.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Нагрузочные измерения сервера.
+ * @details Запускает собранный ./server как отдельный процесс и измеряет
+ *          характеристики, видимые клиенту. Каждый сценарий можно запустить
+ *          отдельно, передав его имя аргументом: bench_server coldstart
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include "journal.h"
+#include "session.h"
+#include "server.h"
+#include "resulttap.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char* kServerBinary = "./server";
+static const char* kBenchConfig = "bench_users.conf";
+static const char* kBenchLog = "bench_server.log";
+static const char* kBenchLogin = "bench";
+static const char* kBenchPassword = "benchpass";
+static const uint16_t kBenchPort = 34001;
+
+/**
+ * @brief Вычисляет SHA-224 в том же виде, что и сервер (hex, верхний регистр).
+ * @param input Входная строка.
+ * @return 56 шестнадцатеричных символов.
+ */
+static std::string sha224Hex(const std::string& input) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    EVP_Digest(input.data(), input.size(), digest, &digestLength, EVP_sha224(), nullptr);
+
+    std::stringstream ss;
+    ss << std::hex << std::uppercase << std::setfill('0');
+    for (unsigned int i = 0; i < digestLength; ++i) {
+        ss << std::setw(2) << static_cast<unsigned int>(digest[i]);
+    }
+    return ss.str();
+}
+
+/**
+ * @brief Подключается к серверу на localhost.
+ * @param port Порт сервера.
+ * @param source Номер адреса-источника 127.0.0.(2 + source) или -1 — выбирает ядро.
+ *        Разные источники нужны, чтобы открыть больше подключений, чем портов.
+ * @return Дескриптор сокета или -1, если подключение не удалось.
+ */
+static int connectTo(uint16_t port, int source = -1) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (source >= 0) {
+        // Порт выбирается при connect(): bind() с портом 0 перебирает занятые порты
+        int one = 1;
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + static_cast<uint32_t>(source));
+        if (bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/**
+ * @brief Читает точное количество байт.
+ * @param ssl TLS-соединение (nullptr — открытый TCP).
+ */
+static bool readAll(int fd, void* buffer, size_t size, SSL* ssl = nullptr) {
+    uint8_t* buf = static_cast<uint8_t*>(buffer);
+    while (size > 0) {
+        ssize_t n = ssl ? SSL_read(ssl, buf, static_cast<int>(std::min<size_t>(size, 1 << 30)))
+                        : recv(fd, buf, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief Отправляет буфер целиком.
+ * @param ssl TLS-соединение (nullptr — открытый TCP).
+ */
+static bool sendAll(int fd, const void* buffer, size_t size, SSL* ssl = nullptr) {
+    const uint8_t* buf = static_cast<const uint8_t*>(buffer);
+    while (size > 0) {
+        ssize_t n = ssl ? SSL_write(ssl, buf, static_cast<int>(std::min<size_t>(size, 1 << 30)))
+                        : send(fd, buf, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief Проходит аутентификацию SHA-224 на стороне клиента.
+ * @return true если сервер ответил OK.
+ */
+static bool clientLogin(int fd, const std::string& login, const std::string& password, SSL* ssl = nullptr) {
+    if (!sendAll(fd, login.data(), login.size(), ssl)) {
+        return false;
+    }
+
+    char salt[17] = {0};
+    if (!readAll(fd, salt, 16, ssl)) {
+        return false;
+    }
+
+    std::string hash = sha224Hex(std::string(salt, 16) + password);
+    if (!sendAll(fd, hash.data(), hash.size(), ssl)) {
+        return false;
+    }
+
+    char reply[2];
+    return readAll(fd, reply, 2, ssl) && reply[0] == 'O' && reply[1] == 'K';
+}
+
+/**
+ * @brief Отправляет пакет векторов и принимает результаты.
+ * @return Результаты в порядке векторов (пусто при ошибке).
+ */
+static std::vector<int16_t> clientRunBatch(int fd, const std::vector<std::vector<int16_t>>& vectors,
+                                           SSL* ssl = nullptr) {
+    std::vector<uint8_t> request;
+    auto append = [&request](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        request.insert(request.end(), bytes, bytes + size);
+    };
+
+    uint32_t count = static_cast<uint32_t>(vectors.size());
+    append(&count, sizeof(count));
+    for (const auto& vector : vectors) {
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        append(&size, sizeof(size));
+        append(vector.data(), vector.size() * sizeof(int16_t));
+    }
+
+    std::vector<int16_t> results(vectors.size());
+    if (!sendAll(fd, request.data(), request.size(), ssl) ||
+        !readAll(fd, results.data(), results.size() * sizeof(int16_t), ssl)) {
+        results.clear();
+    }
+    return results;
+}
+
+/**
+ * @brief Запускает процесс сервера.
+ * @param args Аргументы командной строки (без имени программы).
+ * @param inheritedFd Слушающий сокет для передачи по протоколу LISTEN_FDS (-1 — нет).
+ * @return PID дочернего процесса.
+ */
+static pid_t spawnServer(const std::vector<std::string>& args, int inheritedFd) {
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    dup2(devNull, STDERR_FILENO);
+
+    if (inheritedFd >= 0) {
+        if (inheritedFd != 3) {
+            dup2(inheritedFd, 3);
+            close(inheritedFd);
+        }
+        setenv("LISTEN_FDS", "1", 1);
+        setenv("LISTEN_PID", std::to_string(getpid()).c_str(), 1);
+    }
+
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(kServerBinary));
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(kServerBinary, argv.data());
+    _exit(127);
+}
+
+/**
+ * @brief Останавливает процесс сервера.
+ */
+static void stopServer(pid_t pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+/**
+ * @brief Создает привязанный слушающий сокет на localhost.
+ */
+static int bindListener(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Возвращает медиану выборки.
+ */
+static double median(std::vector<double> samples) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+/**
+ * @brief Создает базу пользователей для измерений.
+ */
+static void writeBenchConfig() {
+    std::ofstream config(kBenchConfig);
+    config << kBenchLogin << ":" << kBenchPassword << "\n";
+}
+
+/**
+ * @brief Один холодный старт: от fork() до получения первого результата.
+ * @param activated true — сокет заранее привязан и передается через LISTEN_FDS.
+ * @return Время в миллисекундах или отрицательное значение при ошибке.
+ */
+static double coldStartOnce(bool activated) {
+    std::vector<std::string> args = {"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog};
+    int listener = activated ? bindListener(kBenchPort) : -1;
+    if (activated && listener < 0) {
+        return -1.0;
+    }
+
+    Clock::time_point begin = Clock::now();
+    pid_t pid = spawnServer(args, listener);
+    if (listener >= 0) {
+        close(listener);
+    }
+
+    // Без активации клиент вынужден повторять connect(), пока сервер не вызовет listen()
+    int fd = -1;
+    while ((fd = connectTo(kBenchPort)) < 0) {
+        if (Clock::now() - begin > std::chrono::seconds(5)) {
+            stopServer(pid);
+            return -1.0;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    bool ok = clientLogin(fd, kBenchLogin, kBenchPassword);
+    ok = ok && clientRunBatch(fd, {{1, 2, 3, 4}}).size() == 1;
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+    close(fd);
+    stopServer(pid);
+    return ok ? elapsed : -1.0;
+}
+
+/**
+ * @brief Сценарий coldstart: время от запуска процесса до первого результата.
+ */
+static void benchColdStart() {
+    const int runs = 20;
+    writeBenchConfig();
+
+    for (bool activated : {false, true}) {
+        std::vector<double> samples;
+        int failures = 0;
+        for (int i = 0; i < runs; ++i) {
+            double ms = coldStartOnce(activated);
+            if (ms < 0) {
+                ++failures;
+            } else {
+                samples.push_back(ms);
+            }
+        }
+
+        std::cout << "coldstart " << (activated ? "socket-activated" : "bind-at-start   ")
+                  << " median " << std::fixed << std::setprecision(2) << median(samples) << " ms"
+                  << " (runs " << samples.size() << ", failures " << failures << ")" << std::endl;
+    }
+
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Возвращает перцентиль выборки.
+ */
+static double percentile(std::vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1));
+    return samples[index];
+}
+
+/**
+ * @brief Сценарий journal: пропускная способность и задержка фиксации журнала.
+ * @details Несколько потоков-«сессий» пишут записи параллельно. В строгом
+ *          режиме каждая сессия ждет фиксации своей записи, как сервер с -S.
+ */
+static void benchJournal() {
+    const char* path = "bench_journal.bin";
+    const int recordsPerThread = 2000;
+
+    for (bool strict : {false, true}) {
+        for (int threads : {1, 4, 16}) {
+            remove(path);
+            ResultJournal journal(path, 1000, 256);
+            if (!journal.open()) {
+                std::cerr << "Cannot open " << path << std::endl;
+                return;
+            }
+
+            std::vector<std::vector<double>> latencies(threads);
+            Clock::time_point begin = Clock::now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&journal, &latencies, t, strict, recordsPerThread] {
+                    for (int i = 0; i < recordsPerThread; ++i) {
+                        Clock::time_point start = Clock::now();
+                        uint64_t sequence = journal.append(ResultRecord::make("bench", 4, 30));
+                        if (strict) {
+                            journal.waitDurable(sequence);
+                            latencies[t].push_back(
+                                std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                        }
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            journal.close();
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+            std::vector<double> all;
+            for (const auto& samples : latencies) {
+                all.insert(all.end(), samples.begin(), samples.end());
+            }
+            uint64_t records = static_cast<uint64_t>(threads) * recordsPerThread;
+            uint64_t commits = journal.getCommitCount();
+
+            std::cout << "journal " << (strict ? "strict " : "async  ") << std::setw(2) << threads << " sessions: "
+                      << std::fixed << std::setprecision(0) << records / seconds << " records/s, "
+                      << commits << " fdatasync, " << std::setprecision(1)
+                      << (commits ? static_cast<double>(records) / commits : 0.0) << " records/commit";
+            if (strict) {
+                std::cout << ", commit latency p50 " << percentile(all, 0.5)
+                          << " us, p99 " << percentile(all, 0.99) << " us";
+            }
+            std::cout << std::endl;
+        }
+    }
+    remove(path);
+}
+
+/**
+ * @brief Читает резидентную память процесса.
+ * @param pid Процесс.
+ * @return VmRSS в килобайтах (0 при ошибке).
+ */
+static long readRssKb(pid_t pid) {
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return std::strtol(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Сценарий idle: память сервера на аутентифицированное простаивающее подключение.
+ * @details Сервер в событийном режиме; число подключений ограничено
+ *          RLIMIT_NOFILE (цель — 100000).
+ */
+static void benchIdleConnections() {
+    const long target = 100000;
+    const long perSource = 25000;
+
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    long connections = std::min<long>(target, static_cast<long>(limit.rlim_max) - 64);
+
+    writeBenchConfig();
+    pid_t pid = spawnServer({"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog, "-e"}, -1);
+
+    int probe = -1;
+    for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (probe < 0) {
+        std::cerr << "idle: server did not start" << std::endl;
+        stopServer(pid);
+        return;
+    }
+    close(probe);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    long baseline = readRssKb(pid);
+
+    std::vector<int> clients;
+    clients.reserve(static_cast<size_t>(connections));
+    Clock::time_point begin = Clock::now();
+    for (long i = 0; i < connections; ++i) {
+        int fd = connectTo(kBenchPort, static_cast<int>(i / perSource));
+        if (fd < 0 || !clientLogin(fd, kBenchLogin, kBenchPassword)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            break;
+        }
+        clients.push_back(fd);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    long loaded = readRssKb(pid);
+
+    double perConnection = clients.empty() ? 0.0
+        : static_cast<double>(loaded - baseline) * 1024.0 / static_cast<double>(clients.size());
+    std::cout << "idle " << clients.size() << " authenticated connections (limit " << connections
+              << ") in " << std::fixed << std::setprecision(1) << seconds << " s" << std::endl;
+    std::cout << "idle server RSS " << baseline << " KiB -> " << loaded << " KiB, "
+              << std::setprecision(0) << perConnection << " bytes/connection (session object "
+              << sizeof(Session) << " bytes), projected for " << target << ": "
+              << std::setprecision(1) << (baseline + perConnection * target / 1024.0) / 1024.0 << " MiB"
+              << std::endl;
+
+    // Сервер закрывается первым, чтобы TIME_WAIT остался на его стороне и не
+    // занимал клиентские порты при повторном запуске
+    stopServer(pid);
+    for (int fd : clients) {
+        close(fd);
+    }
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Читает процессорное время процесса или потока (user + system).
+ * @param statPath Файл /proc/PID/stat или /proc/PID/task/TID/stat.
+ * @return Секунды.
+ */
+static double readCpuSeconds(const std::string& statPath) {
+    std::ifstream stat(statPath);
+    std::string content((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+    size_t end = content.rfind(')');
+    if (end == std::string::npos) {
+        return 0.0;
+    }
+    std::istringstream fields(content.substr(end + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int index = 3; fields >> field && index <= 15; ++index) {
+        if (index == 14) {
+            utime = std::stoull(field);
+        } else if (index == 15) {
+            stime = std::stoull(field);
+        }
+    }
+    return static_cast<double>(utime + stime) / static_cast<double>(sysconf(_SC_CLK_TCK));
+}
+
+/**
+ * @brief Сценарий tls: пропускная способность и затраты процессора сервера
+ *        для открытого TCP, TLS с шифрованием в ядре и TLS в OpenSSL.
+ * @details Клиент во всех вариантах один и тот же; ядро сервера берет на
+ *          себя шифрование, только если поддерживает ULP "tls" (иначе вариант
+ *          ktls совпадает с user и счетчик offload="kernel" остается нулевым).
+ */
+static void benchTls() {
+    const char* certPath = "bench_cert.pem";
+    const char* keyPath = "bench_key.pem";
+    const char* metricsPath = "bench_metrics.prom";
+    const int sessions = 24;
+    const size_t vectorsPerBatch = 16;
+    const size_t elements = 65536;
+
+    std::string command = std::string("openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 ") +
+                          "-nodes -days 1 -subj /CN=localhost -keyout " + keyPath + " -out " + certPath +
+                          " >/dev/null 2>&1";
+    if (std::system(command.c_str()) != 0) {
+        std::cerr << "tls: cannot generate certificate with openssl" << std::endl;
+        return;
+    }
+    writeBenchConfig();
+
+    SSL_CTX* clientContext = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(clientContext, SSL_VERIFY_NONE, nullptr);
+
+    std::vector<std::vector<int16_t>> batch(vectorsPerBatch, std::vector<int16_t>(elements, 3));
+    double megabytes = static_cast<double>(sessions) * vectorsPerBatch * elements * sizeof(int16_t) / (1024.0 * 1024.0);
+
+    const char* names[] = {"tcp ", "ktls", "user"};
+    for (int variant = 0; variant < 3; ++variant) {
+        std::vector<std::string> args = {"-p", std::to_string(kBenchPort), "-c", kBenchConfig,
+                                         "-l", kBenchLog, "-M", metricsPath};
+        if (variant > 0) {
+            args.insert(args.end(), {"-C", certPath, "-K", keyPath});
+        }
+        if (variant == 2) {
+            args.push_back("-U");
+        }
+        remove(metricsPath);
+        pid_t pid = spawnServer(args, -1);
+
+        int probe = -1;
+        for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (probe < 0) {
+            std::cerr << "tls: server did not start" << std::endl;
+            stopServer(pid);
+            continue;
+        }
+        close(probe);
+
+        double cpuBefore = readCpuSeconds("/proc/" + std::to_string(pid) + "/stat");
+        Clock::time_point begin = Clock::now();
+        int completed = 0;
+        for (int i = 0; i < sessions; ++i) {
+            int fd = connectTo(kBenchPort);
+            SSL* ssl = nullptr;
+            if (variant > 0 && fd >= 0) {
+                ssl = SSL_new(clientContext);
+                SSL_set_fd(ssl, fd);
+                if (SSL_connect(ssl) != 1) {
+                    SSL_free(ssl);
+                    close(fd);
+                    continue;
+                }
+            }
+            if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword, ssl) &&
+                clientRunBatch(fd, batch, ssl).size() == vectorsPerBatch) {
+                ++completed;
+            }
+            if (ssl) {
+                SSL_free(ssl);
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        double cpu = readCpuSeconds("/proc/" + std::to_string(pid) + "/stat") - cpuBefore;
+
+        std::ifstream metricsFile(metricsPath);
+        std::string line;
+        std::string offload = "-";
+        while (std::getline(metricsFile, line)) {
+            if (line.find("offload=\"kernel\"") != std::string::npos && variant > 0) {
+                offload = line.substr(line.rfind(' ') + 1) + " kernel";
+            } else if (line.find("offload=\"user\"") != std::string::npos && variant > 0) {
+                offload += ", " + line.substr(line.rfind(' ') + 1) + " user";
+            }
+        }
+        stopServer(pid);
+
+        std::cout << "tls " << names[variant] << " " << completed << "/" << sessions << " sessions, "
+                  << std::fixed << std::setprecision(1) << megabytes / seconds << " MiB/s, server CPU "
+                  << std::setprecision(2) << cpu * 1000.0 / megabytes << " ms/MiB, sessions offloaded: "
+                  << offload << std::endl;
+    }
+
+    SSL_CTX_free(clientContext);
+    remove(certPath);
+    remove(keyPath);
+    remove(metricsPath);
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Читает процессорное время потоков-обработчиков сервера.
+ * @return Секунды по потокам worker-N (индекс — N).
+ */
+static std::vector<double> readWorkerCpuSeconds(pid_t pid, size_t workers) {
+    std::vector<double> seconds(workers, 0.0);
+    std::string taskDir = "/proc/" + std::to_string(pid) + "/task";
+    DIR* dir = opendir(taskDir.c_str());
+    if (!dir) {
+        return seconds;
+    }
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::ifstream comm(taskDir + "/" + entry->d_name + "/comm");
+        std::string name;
+        std::getline(comm, name);
+        if (name.compare(0, 7, "worker-") != 0) {
+            continue;
+        }
+        size_t index = std::strtoul(name.c_str() + 7, nullptr, 10);
+        if (index < workers) {
+            seconds[index] = readCpuSeconds(taskDir + "/" + entry->d_name + "/stat");
+        }
+    }
+    closedir(dir);
+    return seconds;
+}
+
+/**
+ * @brief Сценарий rebalance: равномерность загрузки потоков при неравных клиентах.
+ * @details Подключения раздаются потокам по кругу, и все «тяжелые» клиенты
+ *          (непрерывный поток векторов) попадают на один поток, а остальные
+ *          простаивают после входа. Сравнивается доля процессорного времени
+ *          потоков без балансировки (-R 0) и с ней.
+ */
+static void benchRebalance() {
+    const size_t workers = 4;
+    const int clientsTotal = 16;
+    const uint32_t elements = 4096;
+    const double streamSeconds = 2.0;
+    const char* metricsPath = "bench_metrics.prom";
+
+    writeBenchConfig();
+    std::vector<int16_t> vector(elements, 7);
+    std::vector<uint8_t> chunk(sizeof(uint32_t) + elements * sizeof(int16_t));
+    std::memcpy(chunk.data(), &elements, sizeof(elements));
+    std::memcpy(chunk.data() + sizeof(elements), vector.data(), elements * sizeof(int16_t));
+
+    for (int interval : {0, 100}) {
+        remove(metricsPath);
+        pid_t pid = spawnServer({"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog, "-e",
+                                 "-w", std::to_string(workers), "-R", std::to_string(interval),
+                                 "-M", metricsPath}, -1);
+        int probe = -1;
+        for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (probe < 0) {
+            std::cerr << "rebalance: server did not start" << std::endl;
+            stopServer(pid);
+            continue;
+        }
+        close(probe);
+
+        // Проверочное подключение заняло поток 0: тяжелые клиенты идут с шагом
+        // workers, начиная с того, который снова попадет на поток 0
+        std::vector<int> heavy;
+        std::vector<int> idle;
+        for (int i = 0; i < clientsTotal; ++i) {
+            int fd = connectTo(kBenchPort);
+            if (fd < 0 || !clientLogin(fd, kBenchLogin, kBenchPassword)) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                continue;
+            }
+            ((i + 1) % workers == 0 ? heavy : idle).push_back(fd);
+        }
+        uint32_t batch = 1u << 30;
+        for (int fd : heavy) {
+            sendAll(fd, &batch, sizeof(batch));
+        }
+
+        std::vector<double> before = readWorkerCpuSeconds(pid, workers);
+        Clock::time_point begin = Clock::now();
+        uint64_t vectorsSent = 0;
+        std::vector<uint8_t> results(64 * 1024);
+        while (std::chrono::duration<double>(Clock::now() - begin).count() < streamSeconds) {
+            for (int fd : heavy) {
+                if (sendAll(fd, chunk.data(), chunk.size())) {
+                    ++vectorsSent;
+                }
+                while (recv(fd, results.data(), results.size(), MSG_DONTWAIT) > 0) {
+                }
+            }
+        }
+        std::vector<double> after = readWorkerCpuSeconds(pid, workers);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+        std::string migrated = "0";
+        std::ifstream metricsFile(metricsPath);
+        std::string line;
+        while (std::getline(metricsFile, line)) {
+            if (line.compare(0, 29, "scale_sessions_migrated_total") == 0) {
+                migrated = line.substr(line.rfind(' ') + 1);
+            }
+        }
+        stopServer(pid);
+        for (int fd : heavy) {
+            close(fd);
+        }
+        for (int fd : idle) {
+            close(fd);
+        }
+
+        double total = 0.0;
+        std::vector<double> used(workers);
+        for (size_t w = 0; w < workers; ++w) {
+            used[w] = after[w] - before[w];
+            total += used[w];
+        }
+        std::cout << "rebalance " << (interval ? "on " : "off") << " " << heavy.size() << " heavy + "
+                  << idle.size() << " idle clients, " << std::fixed << std::setprecision(0)
+                  << vectorsSent / streamSeconds << " vectors/s, worker CPU share:";
+        for (size_t w = 0; w < workers; ++w) {
+            std::cout << " " << std::setprecision(0) << (total > 0 ? 100.0 * used[w] / total : 0.0) << "%";
+        }
+        std::cout << ", migrated " << migrated << std::endl;
+    }
+
+    remove(metricsPath);
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Читает значение счетчика из файла, выгруженного сервером с -M.
+ * @return Значение или 0, если счетчика нет.
+ */
+static uint64_t readMetric(const std::string& path, const std::string& name) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.size() > name.size() && line.compare(0, name.size(), name) == 0 && line[name.size()] == ' ') {
+            return std::stoull(line.substr(name.size() + 1));
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Сценарий sockbuf: пакеты из больших и из крошечных векторов с
+ *        буферами ядра по умолчанию (-k) и с подбором под пакет.
+ */
+static void benchSocketBuffers() {
+    const char* metricsPath = "bench_metrics.prom";
+    const int rounds = 5;
+    struct Workload {
+        const char* name;
+        size_t vectors;
+        size_t elements;
+    };
+    const Workload workloads[] = {{"large", 64, 131072}, {"tiny ", 100000, 1}};
+
+    writeBenchConfig();
+    for (const Workload& workload : workloads) {
+        std::vector<std::vector<int16_t>> batch(workload.vectors, std::vector<int16_t>(workload.elements, 2));
+        double megabytes = static_cast<double>(workload.vectors) *
+                           (sizeof(uint32_t) + workload.elements * sizeof(int16_t)) / (1024.0 * 1024.0);
+
+        for (bool tuned : {false, true}) {
+            std::vector<std::string> args = {"-p", std::to_string(kBenchPort), "-c", kBenchConfig,
+                                             "-l", kBenchLog, "-M", metricsPath};
+            if (!tuned) {
+                args.push_back("-k");
+            }
+            remove(metricsPath);
+            pid_t pid = spawnServer(args, -1);
+            int probe = -1;
+            for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            if (probe < 0) {
+                std::cerr << "sockbuf: server did not start" << std::endl;
+                stopServer(pid);
+                continue;
+            }
+            close(probe);
+
+            std::vector<double> samples;
+            for (int round = 0; round < rounds; ++round) {
+                int fd = connectTo(kBenchPort);
+                Clock::time_point begin = Clock::now();
+                if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword) &&
+                    clientRunBatch(fd, batch).size() == workload.vectors) {
+                    samples.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+                }
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            uint64_t receiveBuffer = readMetric(metricsPath, "scale_socket_rcvbuf_bytes");
+            uint64_t sendBuffer = readMetric(metricsPath, "scale_socket_sndbuf_bytes");
+            stopServer(pid);
+
+            double seconds = median(samples);
+            std::cout << "sockbuf " << workload.name << (tuned ? " sized  " : " default") << " "
+                      << std::fixed << std::setprecision(1) << (seconds > 0 ? megabytes / seconds : 0.0)
+                      << " MiB/s, " << std::setprecision(0)
+                      << (seconds > 0 ? workload.vectors / seconds : 0.0) << " vectors/s";
+            if (tuned) {
+                std::cout << ", SO_RCVBUF " << (receiveBuffer ? std::to_string(receiveBuffer) : "auto")
+                          << ", SO_SNDBUF " << sendBuffer;
+            }
+            std::cout << " (rounds " << samples.size() << ")" << std::endl;
+        }
+    }
+
+    remove(metricsPath);
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Открывает счетчик промахов iTLB процесса (со всеми его потоками).
+ * @return Дескриптор счетчика или -1, если аппаратные счетчики недоступны.
+ */
+static int openItlbCounter(pid_t pid) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_ITLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.inherit = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0));
+}
+
+/**
+ * @brief Сценарий hugepages: смешанная нагрузка (аутентификация, пакеты
+ *        векторов разного размера) с кодом на обычных страницах и с -H.
+ */
+static void benchHugePages() {
+    const char* metricsPath = "bench_metrics.prom";
+    const int rounds = 5;
+    const int connections = 300;
+    std::vector<std::vector<int16_t>> batch;
+    for (size_t elements : {1, 7, 64, 300, 4096}) {
+        batch.emplace_back(elements, 3);
+    }
+
+    writeBenchConfig();
+    for (bool huge : {false, true}) {
+        std::vector<std::string> args = {"-p", std::to_string(kBenchPort), "-c", kBenchConfig,
+                                         "-l", kBenchLog, "-M", metricsPath};
+        if (huge) {
+            args.push_back("-H");
+        }
+        remove(metricsPath);
+        pid_t pid = spawnServer(args, -1);
+        int probe = -1;
+        for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (probe < 0) {
+            std::cerr << "hugepages: server did not start" << std::endl;
+            stopServer(pid);
+            continue;
+        }
+        close(probe);
+
+        int counter = openItlbCounter(pid);
+        uint64_t misses = 0;
+        std::vector<double> samples;
+        for (int round = 0; round < rounds; ++round) {
+            Clock::time_point begin = Clock::now();
+            int completed = 0;
+            for (int i = 0; i < connections; ++i) {
+                int fd = connectTo(kBenchPort);
+                if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword) &&
+                    clientRunBatch(fd, batch).size() == batch.size()) {
+                    ++completed;
+                }
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            if (completed == connections) {
+                samples.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+            }
+        }
+        if (counter >= 0) {
+            ssize_t got = read(counter, &misses, sizeof(misses));
+            (void)got;
+            close(counter);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        uint64_t hugeBytes = readMetric(metricsPath, "scale_huge_page_bytes");
+        stopServer(pid);
+
+        double seconds = median(samples);
+        std::cout << "hugepages " << (huge ? "2M text" : "4K text") << " " << std::fixed << std::setprecision(0)
+                  << (seconds > 0 ? connections / seconds : 0.0) << " sessions/s, iTLB misses/session ";
+        if (counter >= 0) {
+            std::cout << std::setprecision(1) << static_cast<double>(misses) / (rounds * connections);
+        } else {
+            std::cout << "n/a (no hardware counters)";
+        }
+        std::cout << ", on huge pages " << hugeBytes / 1024 << " KiB (rounds " << samples.size() << ")"
+                  << std::endl;
+    }
+
+    remove(metricsPath);
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Сценарий auth: стоимость проверки ответа клиента в процессе,
+ *        SHA-224(SALT || PASSWORD) против HMAC с подготовленным ключом,
+ *        а также загрузка большой базы и первый вход в режиме HMAC.
+ */
+static void benchAuth() {
+    const int iterations = 200000;
+    writeBenchConfig();
+    Server server(kBenchPort, kBenchConfig, kBenchLog);
+    server.testLoadUserDatabase();
+
+    std::string salt = server.testGenerateSalt();
+    std::string hash = sha224Hex(salt + kBenchPassword);
+    HmacKey key;
+    key.init(deriveHmacKey(kBenchLogin, kBenchPassword));
+    std::string mac = key.sign(salt);
+
+    for (bool hmac : {false, true}) {
+        int accepted = 0;
+        Clock::time_point begin = Clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            accepted += hmac ? server.testVerifyHmac(kBenchLogin, salt, mac)
+                             : server.testVerifyHash(kBenchLogin, salt, hash);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::cout << "auth " << (hmac ? "hmac  " : "sha224") << " " << std::fixed << std::setprecision(0)
+                  << seconds * 1e9 / iterations << " ns/verification"
+                  << (accepted == iterations ? "" : " (REJECTED)") << std::endl;
+    }
+
+    // Стоимость запуска растет с базой, только если ключи выводятся при загрузке
+    const int users = 2000;
+    {
+        std::ofstream config(kBenchConfig);
+        for (int i = 0; i < users; ++i) {
+            config << "user" << i << ":password" << i << "\n";
+        }
+        config << kBenchLogin << ":" << kBenchPassword << "\n";
+    }
+    Server loaded(kBenchPort, kBenchConfig, kBenchLog);
+    Clock::time_point loadBegin = Clock::now();
+    loaded.testLoadUserDatabase();
+    double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - loadBegin).count();
+    Clock::time_point firstBegin = Clock::now();
+    bool firstAccepted = loaded.testVerifyHmac(kBenchLogin, salt, mac);
+    double firstUs = std::chrono::duration<double, std::micro>(Clock::now() - firstBegin).count();
+    std::cout << "auth load " << users + 1 << " users " << std::fixed << std::setprecision(1) << loadMs
+              << " ms, first hmac login " << std::setprecision(0) << firstUs << " us"
+              << (firstAccepted ? "" : " (REJECTED)") << std::endl;
+
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Сценарий tap: пакет крошечных векторов без кольца и с кольцом
+ *        результатов, которое параллельно читает локальный потребитель.
+ */
+static void benchResultTap() {
+    const char* ringName = "/scale-bench-results";
+    const int rounds = 5;
+    const size_t vectors = 100000;
+    std::vector<std::vector<int16_t>> batch(vectors, std::vector<int16_t>(1, 2));
+
+    writeBenchConfig();
+    for (bool tapped : {false, true}) {
+        std::vector<std::string> args = {"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog, "-e"};
+        if (tapped) {
+            // Остановленный сигналом сервер оставляет кольцо: имя принадлежит стенду, заменяем
+            args.push_back("-r");
+            args.push_back(ringName);
+            args.push_back("-O");
+        }
+        pid_t pid = spawnServer(args, -1);
+        int probe = -1;
+        for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (probe < 0) {
+            std::cerr << "tap: server did not start" << std::endl;
+            stopServer(pid);
+            continue;
+        }
+        close(probe);
+
+        // Потребитель читает кольцо на месте, пока сервер не закроет его
+        std::atomic<bool> stop{false};
+        uint64_t received = 0;
+        uint64_t missed = 0;
+        std::thread consumer;
+        if (tapped) {
+            consumer = std::thread([&] {
+                ResultTapReader reader(ringName);
+                if (!reader.open()) {
+                    return;
+                }
+                ResultRecord record;
+                while (!stop.load()) {
+                    TapRead status = reader.next(record);
+                    if (status == TapRead::Record) {
+                        ++received;
+                    } else if (status == TapRead::Empty) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    } else if (status == TapRead::Closed) {
+                        break;
+                    }
+                }
+                missed = reader.getMissed();
+            });
+        }
+
+        std::vector<double> samples;
+        for (int round = 0; round < rounds; ++round) {
+            int fd = connectTo(kBenchPort);
+            Clock::time_point begin = Clock::now();
+            if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword) && clientRunBatch(fd, batch).size() == vectors) {
+                samples.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        stop = true;
+        if (consumer.joinable()) {
+            consumer.join();
+        }
+        stopServer(pid);
+
+        double seconds = median(samples);
+        std::cout << "tap " << (tapped ? "ring   " : "no ring") << " " << std::fixed << std::setprecision(0)
+                  << (seconds > 0 ? vectors / seconds : 0.0) << " vectors/s";
+        if (tapped) {
+            std::cout << ", consumer received " << received << ", missed " << missed;
+        }
+        std::cout << " (rounds " << samples.size() << ")" << std::endl;
+    }
+
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Сценарий microbatch: тысячи подключений по одному пакету из двух
+ *        крошечных векторов, с общими проходами и без них.
+ * @details Все подключения аутентифицируются заранее; измеряется время от
+ *          отправки всех пакетов до получения всех результатов и процессорное
+ *          время сервера на вектор. Сервер и клиент делят процессоры машины.
+ */
+static void benchMicroBatch() {
+    const size_t connections = 2000;
+    const int rounds = 5;
+    const char* metricsFile = "bench_microbatch.prom";
+    std::vector<std::vector<int16_t>> batch = {{3, -4}, {7}};
+    std::vector<uint8_t> request;
+    uint32_t count = static_cast<uint32_t>(batch.size());
+    request.insert(request.end(), reinterpret_cast<uint8_t*>(&count), reinterpret_cast<uint8_t*>(&count) + 4);
+    for (const auto& vector : batch) {
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        request.insert(request.end(), reinterpret_cast<uint8_t*>(&size), reinterpret_cast<uint8_t*>(&size) + 4);
+        request.insert(request.end(), reinterpret_cast<const uint8_t*>(vector.data()),
+                       reinterpret_cast<const uint8_t*>(vector.data() + vector.size()));
+    }
+
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    writeBenchConfig();
+    for (const char* lanes : {"0", "256"}) {
+        pid_t pid = spawnServer({"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog, "-e",
+                                 "-b", lanes, "-t", "20", "-M", metricsFile}, -1);
+        int probe = -1;
+        for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (probe < 0) {
+            std::cerr << "microbatch: server did not start" << std::endl;
+            stopServer(pid);
+            continue;
+        }
+        close(probe);
+
+        std::string statPath = "/proc/" + std::to_string(pid) + "/stat";
+        std::vector<double> samples;
+        double cpuSeconds = 0.0;
+        size_t vectors = 0;
+        for (int round = 0; round < rounds; ++round) {
+            std::vector<int> clients;
+            for (size_t i = 0; i < connections; ++i) {
+                int fd = connectTo(kBenchPort);
+                if (fd < 0 || !clientLogin(fd, kBenchLogin, kBenchPassword)) {
+                    if (fd >= 0) {
+                        close(fd);
+                    }
+                    break;
+                }
+                clients.push_back(fd);
+            }
+
+            double cpuBefore = readCpuSeconds(statPath);
+            Clock::time_point begin = Clock::now();
+            bool ok = clients.size() == connections;
+            for (int fd : clients) {
+                ok = sendAll(fd, request.data(), request.size()) && ok;
+            }
+            for (int fd : clients) {
+                int16_t results[2];
+                ok = readAll(fd, results, sizeof(results)) && results[0] == 25 && results[1] == 49 && ok;
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+            if (ok) {
+                samples.push_back(seconds);
+                cpuSeconds += readCpuSeconds(statPath) - cpuBefore;
+                vectors += connections * batch.size();
+            }
+            for (int fd : clients) {
+                close(fd);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+        uint64_t passes = readMetric(metricsFile, "scale_microbatches_total");
+        uint64_t batched = readMetric(metricsFile, "scale_microbatch_lanes_total");
+        stopServer(pid);
+
+        double seconds = median(samples);
+        std::cout << "microbatch lanes " << std::setw(3) << lanes << " " << std::fixed << std::setprecision(0)
+                  << (seconds > 0 ? connections * batch.size() / seconds : 0.0) << " vectors/s, server "
+                  << std::setprecision(2) << (vectors ? cpuSeconds * 1e6 / vectors : 0.0) << " us CPU/vector";
+        if (passes > 0) {
+            std::cout << ", " << std::setprecision(1) << static_cast<double>(batched) / passes << " lanes/pass";
+        }
+        std::cout << " (rounds " << samples.size() << ")" << std::endl;
+    }
+
+    remove(kBenchConfig);
+    remove(kBenchLog);
+    remove(metricsFile);
+}
+
+/**
+ * @brief Сценарий ranges: суммы квадратов окон длинной записи — запросом
+ *        по диапазонам к хранимому вектору и повторной отправкой окон.
+ */
+static void benchRanges() {
+    const uint32_t recordLength = 1u << 20;
+    const uint32_t window = 50000;
+    const uint32_t ranges = 100000;
+    const uint32_t resentWindows = 200;
+
+    std::vector<int16_t> record(recordLength);
+    for (uint32_t i = 0; i < recordLength; ++i) {
+        record[i] = static_cast<int16_t>(i % 7) - 3;
+    }
+    std::vector<uint32_t> starts(ranges);
+    for (uint32_t i = 0; i < ranges; ++i) {
+        starts[i] = static_cast<uint32_t>((static_cast<uint64_t>(i) * 2654435761u) % (recordLength - window));
+    }
+
+    writeBenchConfig();
+    pid_t pid = spawnServer({"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog, "-k"}, -1);
+    int fd = -1;
+    for (int attempt = 0; attempt < 200 && (fd = connectTo(kBenchPort)) < 0; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (fd < 0) {
+        std::cerr << "ranges: server did not start" << std::endl;
+        stopServer(pid);
+        return;
+    }
+
+    // Загрузка записи: ответ приходит после построения индекса
+    Clock::time_point begin = Clock::now();
+    uint32_t header[2] = {kStoreVectorFlag, recordLength};
+    uint32_t handle = 0;
+    bool ok = clientLogin(fd, kBenchLogin, kBenchPassword) && sendAll(fd, header, sizeof(header)) &&
+              sendAll(fd, record.data(), record.size() * sizeof(int16_t)) && readAll(fd, &handle, sizeof(handle)) &&
+              handle != 0;
+    double uploadSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    close(fd);
+
+    double querySeconds = 0.0;
+    fd = ok ? connectTo(kBenchPort) : -1;
+    if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword)) {
+        std::vector<uint32_t> request = {kRangeQueryFlag | ranges, handle};
+        for (uint32_t start : starts) {
+            request.push_back(start);
+            request.push_back(start + window);
+        }
+        std::vector<int16_t> results(ranges);
+        begin = Clock::now();
+        ok = sendAll(fd, request.data(), request.size() * sizeof(uint32_t)) &&
+             readAll(fd, results.data(), results.size() * sizeof(int16_t)) && results[0] == 32767;
+        querySeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    double resendSeconds = 0.0;
+    fd = connectTo(kBenchPort);
+    if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword)) {
+        std::vector<std::vector<int16_t>> slices;
+        for (uint32_t i = 0; i < resentWindows; ++i) {
+            slices.emplace_back(record.begin() + starts[i], record.begin() + starts[i] + window);
+        }
+        begin = Clock::now();
+        ok = clientRunBatch(fd, slices).size() == resentWindows && ok;
+        resendSeconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    stopServer(pid);
+
+    std::cout << std::fixed << std::setprecision(1) << "ranges upload " << recordLength << " elements + index "
+              << uploadSeconds * 1e3 << " ms" << (ok ? "" : " (FAILED)") << std::endl;
+    std::cout << std::setprecision(3) << "ranges query  " << ranges << " windows of " << window << ": "
+              << querySeconds * 1e6 / ranges << " us/window" << std::endl;
+    std::cout << "ranges resend " << resentWindows << " windows of " << window << ": "
+              << resendSeconds * 1e6 / resentWindows << " us/window" << std::endl;
+
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Сценарий overlap: пропускная способность одного подключения
+ *        последовательного режима на пакете больших векторов.
+ */
+static void benchOverlap() {
+    const size_t vectors = 32;
+    const size_t elements = 2 * 1024 * 1024;
+    const int rounds = 3;
+    std::vector<std::vector<int16_t>> batch(vectors, std::vector<int16_t>(elements));
+    for (auto& vector : batch) {
+        for (size_t i = 0; i < elements; ++i) {
+            vector[i] = static_cast<int16_t>(i % 3) - 1;
+        }
+        vector[0] = 0;
+    }
+
+    writeBenchConfig();
+    pid_t pid = spawnServer({"-p", std::to_string(kBenchPort), "-c", kBenchConfig, "-l", kBenchLog}, -1);
+    int probe = -1;
+    for (int attempt = 0; attempt < 200 && (probe = connectTo(kBenchPort)) < 0; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (probe < 0) {
+        std::cerr << "overlap: server did not start" << std::endl;
+        stopServer(pid);
+        return;
+    }
+    close(probe);
+
+    std::vector<double> samples;
+    for (int round = 0; round < rounds; ++round) {
+        int fd = connectTo(kBenchPort);
+        if (fd >= 0 && clientLogin(fd, kBenchLogin, kBenchPassword)) {
+            Clock::time_point begin = Clock::now();
+            if (clientRunBatch(fd, batch).size() == vectors) {
+                samples.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    stopServer(pid);
+
+    double megabytes = static_cast<double>(vectors * elements * sizeof(int16_t)) / (1024.0 * 1024.0);
+    double seconds = median(samples);
+    std::cout << "overlap " << vectors << " x " << elements << " elements: " << std::fixed << std::setprecision(1)
+              << (seconds > 0 ? megabytes / seconds : 0.0) << " MiB/s (rounds " << samples.size() << ")" << std::endl;
+
+    remove(kBenchConfig);
+    remove(kBenchLog);
+}
+
+/**
+ * @brief Точка входа: запускает все сценарии либо перечисленные в аргументах.
+ */
+int main(int argc, char* argv[]) {
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::string> selected(argv + 1, argv + argc);
+    auto wanted = [&selected](const std::string& name) {
+        return selected.empty() || std::find(selected.begin(), selected.end(), name) != selected.end();
+    };
+
+    if (access(kServerBinary, X_OK) != 0) {
+        std::cerr << "Build the server first: make server" << std::endl;
+        return 1;
+    }
+
+    if (wanted("coldstart")) {
+        benchColdStart();
+    }
+    if (wanted("journal")) {
+        benchJournal();
+    }
+    if (wanted("idle")) {
+        benchIdleConnections();
+    }
+    if (wanted("tls")) {
+        benchTls();
+    }
+    if (wanted("rebalance")) {
+        benchRebalance();
+    }
+    if (wanted("sockbuf")) {
+        benchSocketBuffers();
+    }
+    if (wanted("hugepages")) {
+        benchHugePages();
+    }
+    if (wanted("auth")) {
+        benchAuth();
+    }
+    if (wanted("tap")) {
+        benchResultTap();
+    }
+    if (wanted("microbatch")) {
+        benchMicroBatch();
+    }
+    if (wanted("ranges")) {
+        benchRanges();
+    }
+    if (wanted("overlap")) {
+        benchOverlap();
+    }
+    return 0;
+}
@@ -0,0 +1,838 @@
+/**
+ * @file eventloop.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация событийного цикла сервера на epoll.
+ */
+
+#include "eventloop.h"
+#include "server.h"
+#include "journal.h"
+#include "resulttap.h"
+#include "sockettune.h"
+#include "watchdog.h"
+#include "hmacauth.h"
+#include "pipeline.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+/// Количество событий, забираемых одним вызовом epoll_wait().
+static const int kMaxEvents = 256;
+
+/// Период проверки сроков пакетов, мс.
+static const int kDeadlineTickMs = 5;
+
+/// Период выгрузки счетчиков, мс.
+static const int kMetricsIntervalMs = 1000;
+
+/// События чтения: данные и закрытие клиентом своей стороны.
+static const uint32_t kReadEvents = EPOLLIN | EPOLLRDHUP;
+
+/**
+ * @brief Возвращает монотонное время в миллисекундах.
+ */
+static int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Проверяет, что сессия между пакетами и ее состояние целиком в Session.
+ * @details Аутентифицированная сессия, не начавшая пакет: нет неотправленных
+ *          результатов, ожидания журнала и векторов в общем проходе.
+ */
+static bool atBatchBoundary(const Session* session) {
+    return session->stage == SessionStage::ReadCount && session->headerFill == 0 && !session->outbox &&
+           !session->awaitingDurable && session->batchedLanes == 0;
+}
+
+/**
+ * @brief Возвращает имя этапа сессии для сторожа зависаний.
+ */
+static const char* stageName(SessionStage stage) {
+    static const char* const names[] = {"read-login", "read-hash", "read-count", "read-deadline",
+                                        "read-size", "read-data", "draining", "closing"};
+    return names[static_cast<size_t>(stage)];
+}
+
+/**
+ * @brief Конструктор цикла.
+ * @param server Сервер.
+ * @param listenSocket Слушающий сокет.
+ */
+EventLoop::EventLoop(Server& server, int listenSocket)
+    : server(server), listenSocket(listenSocket), scratch(BufferPool::kBufferSize),
+      batch(server.batchLanes, server.batchWindowUs) {
+    // Создается сразу: другие циклы могут передавать подключения еще до run()
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+EventLoop::~EventLoop() {
+    server.forgetHmacWaiter(this);
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+}
+
+bool EventLoop::run() {
+    // Каждое подключение — дескриптор: поднимаем мягкий предел до жесткого
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        server.logError("Cannot create epoll instance", true);
+        return false;
+    }
+
+    if (listenSocket >= 0) {
+        fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL) | O_NONBLOCK);
+        epoll_event listenEvent{};
+        listenEvent.events = EPOLLIN;
+        listenEvent.data.ptr = nullptr;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &listenEvent) < 0) {
+            server.logError("Cannot watch listening socket", true);
+            return false;
+        }
+    }
+
+    epoll_event wakeEvent{};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.ptr = this;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wakeEvent) < 0) {
+        server.logError("Cannot watch handoff queue", true);
+        return false;
+    }
+
+    if (server.watchdog) {
+        heartbeat = server.watchdog->attach(name);
+    }
+
+    epoll_event events[kMaxEvents];
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (heartbeat) {
+            heartbeat->idle();
+        }
+        int ready;
+        if (batch.empty()) {
+            ready = epoll_wait(epollFd, events, kMaxEvents, pollTimeout());
+        } else {
+            // Накопленные векторы ждут не дольше окна: таймаут с точностью до наносекунд
+            int64_t left = batch.remainingNs(std::chrono::steady_clock::now());
+            timespec timeout{static_cast<time_t>(left / 1000000000), static_cast<long>(left % 1000000000)};
+            ready = epoll_pwait2(epollFd, events, kMaxEvents, &timeout, nullptr);
+            if (ready < 0 && errno == ENOSYS) {
+                ready = 0;
+            }
+        }
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            server.logError("epoll_wait failed", true);
+            return false;
+        }
+        std::chrono::steady_clock::time_point busySince = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.ptr == this) {
+                if (heartbeat) {
+                    heartbeat->beat("handoff", -1);
+                }
+                adoptPending();
+                if (keysDerived.exchange(false, std::memory_order_acquire)) {
+                    resumeAwaitingKey();
+                }
+                continue;
+            }
+            Session* session = static_cast<Session*>(events[i].data.ptr);
+            if (!session) {
+                if (heartbeat) {
+                    heartbeat->beat("accept", listenSocket);
+                }
+                acceptClients();
+                continue;
+            }
+            if (session->stage == SessionStage::Closing) {
+                continue;
+            }
+            if (heartbeat) {
+                heartbeat->beat(stageName(session->stage), session->fd);
+            }
+            if (!(events[i].events & EPOLLOUT) && migrationBudget.load(std::memory_order_relaxed) > 0 &&
+                (migrate(session) || session->stage == SessionStage::Closing)) {
+                continue;
+            }
+            if ((events[i].events & (EPOLLHUP | EPOLLERR)) && !(events[i].events & EPOLLIN)) {
+                // Соединение разорвано полностью: непрочитанных данных нет
+                cancelSession(session, false);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                onWritable(session);
+            } else {
+                onReadable(session);
+            }
+        }
+
+        if (!batch.empty() && (ready == 0 || batch.remainingNs(busySince) == 0)) {
+            flushBatch();
+        }
+
+        // Простаивающие сессии событий не получают: отдаем их сразу по запросу.
+        // Перенос после обхода событий — в events[] не остается указателей на них
+        if (migrationRequested.exchange(false, std::memory_order_acquire)) {
+            migrateIdle();
+        }
+
+        // Групповая фиксация: одно ожидание на все результаты итерации
+        if (!awaitingDurable.empty()) {
+            if (heartbeat) {
+                heartbeat->beat("journal-wait", -1);
+            }
+            bool durable = server.journal->waitDurable(lastSequence);
+            for (Session* session : awaitingDurable) {
+                session->awaitingDurable = false;
+                if (session->stage == SessionStage::Closing) {
+                    continue;
+                }
+                if (!durable) {
+                    server.logError("Result journal write failed, results not acknowledged", true);
+                    closeSession(session);
+                    continue;
+                }
+                flushOutbox(session);
+            }
+            awaitingDurable.clear();
+        }
+
+        // Счетчики выгружает только принимающий цикл, чтобы файл не писали несколько потоков
+        bool exportMetrics = listenSocket >= 0 && !server.metricsPath.empty();
+        int64_t now = (deadlines.empty() && !exportMetrics) ? 0 : steadyMs();
+        if (!deadlines.empty()) {
+            expireDeadlines(now);
+        }
+        if (exportMetrics && now >= nextMetricsWrite) {
+            server.metrics.writeTo(server.metricsPath);
+            nextMetricsWrite = now + kMetricsIntervalMs;
+        }
+
+        // Сессия, на которую ссылаются дорожки прохода, освобождается после него
+        size_t kept = 0;
+        for (Session* session : closing) {
+            if (session->batchedLanes > 0) {
+                closing[kept++] = session;
+            } else {
+                sessions.destroy(session);
+            }
+        }
+        closing.resize(kept);
+
+        load.busyNs.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - busySince).count()),
+                              std::memory_order_relaxed);
+        load.sessions.store(static_cast<uint32_t>(sessions.size()), std::memory_order_relaxed);
+        if (ready > 0) {
+            load.readyEvents.fetch_add(static_cast<uint64_t>(ready), std::memory_order_relaxed);
+            load.wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return true;
+}
+
+void EventLoop::stop() {
+    stopping.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+int EventLoop::pollTimeout() const {
+    if (!deadlines.empty()) {
+        return kDeadlineTickMs;
+    }
+    return (listenSocket < 0 || server.metricsPath.empty()) ? -1 : kMetricsIntervalMs;
+}
+
+bool EventLoop::adopt(const Session& state) {
+    if (!inbox.push(state)) {
+        return false;
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+    return true;
+}
+
+void EventLoop::hmacKeyDerived() {
+    keysDerived.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void EventLoop::requestMigration(EventLoop* target, uint32_t count) {
+    migrationTarget.store(target, std::memory_order_relaxed);
+    migrationBudget.store(count, std::memory_order_relaxed);
+    migrationRequested.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void EventLoop::adoptPending() {
+    uint64_t counter;
+    ssize_t drained = read(wakeFd, &counter, sizeof(counter));
+    (void)drained;
+
+    Session state;
+    while (inbox.pop(state)) {
+        Session* session = sessions.create();
+        *session = state;
+        session->idleSlot = kNotIdle;
+        if (session->deadlineMs != 0) {
+            trackDeadline(session);
+        }
+        if (attach(session) && atBatchBoundary(session)) {
+            markIdle(session);
+        }
+    }
+}
+
+bool EventLoop::attach(Session* session) {
+    epoll_event event{};
+    event.events = kReadEvents;
+    event.data.ptr = session;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, session->fd, &event) < 0) {
+        server.logError("Cannot watch client connection", false);
+        closeSession(session);
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::migrate(Session* session) {
+    // Внутри пакета часть состояния принадлежит циклу (буфер результатов,
+    // журнал, общий проход): переносим только между пакетами
+    if (!atBatchBoundary(session)) {
+        return false;
+    }
+    EventLoop* target = migrationTarget.load(std::memory_order_relaxed);
+    if (!target || target == this) {
+        return false;
+    }
+
+    // Сначала снимаем сокет с наблюдения: после передачи его читает только получатель
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, session->fd, nullptr);
+    Session state = *session;
+    if (!target->adopt(state)) {
+        attach(session);
+        migrationBudget.store(0, std::memory_order_relaxed);
+        return false;
+    }
+
+    clearIdle(session);
+    disarmDeadline(session);
+    sessions.destroy(session);
+    uint32_t budget = migrationBudget.load(std::memory_order_relaxed);
+    if (budget > 0) {
+        migrationBudget.store(budget - 1, std::memory_order_relaxed);
+    }
+    server.metrics.sessionsMigrated++;
+    return true;
+}
+
+void EventLoop::migrateIdle() {
+    // Обход с конца: перенос сессии ставит на ее место последнюю
+    for (size_t i = idle.size(); i-- > 0 && migrationBudget.load(std::memory_order_relaxed) > 0;) {
+        if (i < idle.size()) {
+            migrate(idle[i]);
+        }
+    }
+}
+
+void EventLoop::markIdle(Session* session) {
+    session->idleSlot = static_cast<uint32_t>(idle.size());
+    idle.push_back(session);
+}
+
+void EventLoop::clearIdle(Session* session) {
+    if (session->idleSlot == kNotIdle) {
+        return;
+    }
+    Session* last = idle.back();
+    idle[session->idleSlot] = last;
+    last->idleSlot = session->idleSlot;
+    idle.pop_back();
+    session->idleSlot = kNotIdle;
+}
+
+void EventLoop::armDeadline(Session* session, uint32_t milliseconds) {
+    session->deadlineMs = steadyMs() + milliseconds;
+    trackDeadline(session);
+}
+
+void EventLoop::trackDeadline(Session* session) {
+    session->deadlineSlot = static_cast<uint32_t>(deadlines.size());
+    deadlines.push_back(session);
+}
+
+void EventLoop::disarmDeadline(Session* session) {
+    if (session->deadlineMs == 0) {
+        return;
+    }
+    Session* last = deadlines.back();
+    deadlines[session->deadlineSlot] = last;
+    last->deadlineSlot = session->deadlineSlot;
+    deadlines.pop_back();
+    session->deadlineMs = 0;
+}
+
+void EventLoop::expireDeadlines(int64_t now) {
+    // Обход с конца: снятие с контроля переносит последний элемент на место текущего
+    for (size_t i = deadlines.size(); i-- > 0;) {
+        if (i < deadlines.size() && deadlines[i]->deadlineMs <= now) {
+            cancelSession(deadlines[i], true);
+        }
+    }
+}
+
+void EventLoop::cancelSession(Session* session, bool deadlineExpired) {
+    bool inBatch = session->stage == SessionStage::ReadSize || session->stage == SessionStage::ReadData ||
+                   session->stage == SessionStage::ReadDeadline ||
+                   (session->stage == SessionStage::ReadCount && session->headerFill > 0);
+    if (inBatch) {
+        uint32_t vectorsLeft = session->stage == SessionStage::ReadCount || session->stage == SessionStage::ReadDeadline
+                                   ? 0 : session->numVectors - session->vectorIndex;
+        server.cancelBatch(deadlineExpired ? Server::BatchCancel::Deadline : Server::BatchCancel::Disconnect,
+                           vectorsLeft);
+    } else if (session->outbox) {
+        server.logError("Failed to send result for vector " + std::to_string(session->vectorIndex), false);
+    }
+    closeSession(session);
+}
+
+void EventLoop::acceptClients() {
+    while (true) {
+        int clientSocket = accept4(listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                server.logError("Cannot accept client connection", false);
+            }
+            return;
+        }
+
+        server.metrics.connectionsAccepted++;
+        server.logError("New client connection established", false);
+        if (server.socketTuning) {
+            applyNotSentLowat(clientSocket);
+        }
+
+        // В пуле подключения раздаются циклам по кругу
+        if (!peers.empty()) {
+            EventLoop* peer = peers[nextPeer++ % peers.size()];
+            Session state;
+            state.fd = clientSocket;
+            if (peer != this && peer->adopt(state)) {
+                continue;
+            }
+        }
+
+        Session* session = sessions.create();
+        session->fd = clientSocket;
+        attach(session);
+    }
+}
+
+void EventLoop::onReadable(Session* session) {
+    if (session->stage == SessionStage::ReadLogin) {
+        handleLogin(session);
+        return;
+    }
+    if (session->stage == SessionStage::ReadHash) {
+        handleHash(session);
+        return;
+    }
+
+    ssize_t bytesRead = recv(session->fd, scratch.data(), scratch.size(), 0);
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (bytesRead <= 0) {
+        if (session->stage == SessionStage::ReadCount && session->headerFill == 0) {
+            server.logError("Failed to read number of vectors", false);
+            closeSession(session);
+        } else {
+            server.logError("Failed to read vector data", false);
+            cancelSession(session, false);
+        }
+        return;
+    }
+
+    clearIdle(session);
+    consume(session, scratch.data(), static_cast<size_t>(bytesRead));
+    // Результаты векторов в дорожках отправит общий проход
+    if (session->stage == SessionStage::Closing || session->batchedLanes > 0) {
+        return;
+    }
+    deliver(session);
+}
+
+void EventLoop::deliver(Session* session) {
+    if (session->outbox) {
+        if (server.journal && server.journalStrict) {
+            if (!session->awaitingDurable) {
+                session->awaitingDurable = true;
+                awaitingDurable.push_back(session);
+            }
+        } else {
+            flushOutbox(session);
+        }
+    } else if (session->stage == SessionStage::Draining) {
+        server.logError("Client connection closed", false);
+        closeSession(session);
+    }
+}
+
+void EventLoop::onWritable(Session* session) {
+    flushOutbox(session);
+    if (session->stage != SessionStage::Closing && !session->outbox) {
+        watch(session, false);
+    }
+}
+
+void EventLoop::handleLogin(Session* session) {
+    char buffer[256];
+    ssize_t bytesRead = recv(session->fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (bytesRead <= 0) {
+        server.logError("No data received from client for login", false);
+        closeSession(session);
+        return;
+    }
+    buffer[bytesRead] = '\0';
+    std::string login(buffer);
+    session->hmacAuth = takeHmacPrefix(login);
+
+    if (login.size() > kSessionLoginSize || server.users.find(login) == server.users.end()) {
+        send(session->fd, "ERR", 3, MSG_NOSIGNAL);
+        server.logError("Identification failed for login: " + login, false);
+        closeSession(session);
+        return;
+    }
+
+    std::memcpy(session->login, login.data(), login.size());
+    session->loginLength = static_cast<uint8_t>(login.size());
+    if (session->hmacAuth) {
+        // Ключ выводится, пока клиент считает ответ на соль
+        server.awaitHmacKey(login, nullptr);
+    }
+
+    std::string salt = server.generateSalt();
+    std::memcpy(session->salt, salt.data(), kSessionSaltSize);
+    if (send(session->fd, session->salt, kSessionSaltSize, MSG_NOSIGNAL) != static_cast<ssize_t>(kSessionSaltSize)) {
+        server.logError("Failed to send salt to client", false);
+        closeSession(session);
+        return;
+    }
+    session->stage = SessionStage::ReadHash;
+}
+
+void EventLoop::handleHash(Session* session) {
+    std::string login(session->login, session->loginLength);
+    if (session->hmacAuth && !session->keyAwaited && server.awaitHmacKey(login, this)) {
+        // Ответ клиента остается в сокете, пока поток вывода не закончит PBKDF2
+        session->keyAwaited = true;
+        epoll_event event{};
+        event.data.ptr = session;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, session->fd, &event);
+        awaitingKey.push_back(session);
+        return;
+    }
+
+    char buffer[256];
+    ssize_t bytesRead = recv(session->fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (bytesRead <= 0) {
+        server.logError("No hash received from client", false);
+        closeSession(session);
+        return;
+    }
+    buffer[bytesRead] = '\0';
+
+    std::string salt(session->salt, kSessionSaltSize);
+    bool verified = false;
+    if (session->hmacAuth) {
+        const HmacKey* key = server.findHmacKey(login);
+        verified = key && key->verify(salt, buffer);
+    } else {
+        verified = server.verifyHash(login, salt, buffer);
+    }
+    if (!verified) {
+        send(session->fd, "ERR", 3, MSG_NOSIGNAL);
+        server.logError("Authentication failed for login: " + login, false);
+        closeSession(session);
+        return;
+    }
+
+    send(session->fd, "OK", 2, MSG_NOSIGNAL);
+    server.logError("Authentication successful for login: " + login, false);
+    session->stage = SessionStage::ReadCount;
+    markIdle(session);
+}
+
+void EventLoop::resumeAwaitingKey() {
+    size_t kept = 0;
+    for (Session* session : awaitingKey) {
+        if (server.hmacKeyDerived(std::string(session->login, session->loginLength))) {
+            watch(session, false);
+        } else {
+            awaitingKey[kept++] = session;
+        }
+    }
+    awaitingKey.resize(kept);
+}
+
+void EventLoop::consume(Session* session, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        switch (session->stage) {
+        case SessionStage::ReadCount:
+        case SessionStage::ReadDeadline:
+        case SessionStage::ReadSize: {
+            size_t take = std::min(size, sizeof(session->header) - session->headerFill);
+            std::memcpy(session->header + session->headerFill, data, take);
+            session->headerFill = static_cast<uint8_t>(session->headerFill + take);
+            data += take;
+            size -= take;
+            if (session->headerFill < sizeof(session->header)) {
+                return;
+            }
+
+            // КЛИЕНТ ОТПРАВЛЯЕТ В LITTLE-ENDIAN - оставляем как есть
+            uint32_t value;
+            std::memcpy(&value, session->header, sizeof(value));
+            session->headerFill = 0;
+
+            if (session->stage == SessionStage::ReadCount) {
+                if (value & (kStoreVectorFlag | kRangeQueryFlag)) {
+                    server.logError("Stored vectors and range queries are supported in sequential mode only", false);
+                    closeSession(session);
+                    return;
+                }
+                session->numVectors = value & ~kBatchDeadlineFlag;
+                session->vectorIndex = 0;
+                if (value & kBatchDeadlineFlag) {
+                    session->stage = SessionStage::ReadDeadline;
+                } else {
+                    session->stage = session->numVectors == 0 ? SessionStage::Draining : SessionStage::ReadSize;
+                }
+            } else if (session->stage == SessionStage::ReadDeadline) {
+                armDeadline(session, value);
+                session->stage = session->numVectors == 0 ? SessionStage::Draining : SessionStage::ReadSize;
+            } else {
+                if (session->vectorIndex == 0 && server.socketTuning) {
+                    tuneSocketBuffers(session->fd, session->numVectors, value, server.metrics);
+                }
+                if (batch.fits(value) && size >= value * sizeof(int16_t)) {
+                    // Вектор целиком в принятых байтах: считается в общем проходе с другими сессиями
+                    bool full = batch.add(session, data, value);
+                    ++session->batchedLanes;
+                    data += value * sizeof(int16_t);
+                    size -= value * sizeof(int16_t);
+                    session->vectorSize = value;
+                    advanceVector(session);
+                    if (full) {
+                        flushBatch();
+                    }
+                    break;
+                }
+                session->vectorSize = value;
+                session->elementsLeft = value;
+                session->square = SquareSum();
+                session->stage = SessionStage::ReadData;
+                if (value == 0) {
+                    completeVector(session);
+                }
+            }
+            break;
+        }
+        case SessionStage::ReadData: {
+            // Байты текущего вектора, включая вторую половину элемента, разорванного между recv()
+            size_t vectorBytes = static_cast<size_t>(session->elementsLeft) * sizeof(int16_t) -
+                                 (session->square.hasOddByte ? 1 : 0);
+            size_t take = std::min(size, vectorBytes);
+            session->elementsLeft -= static_cast<uint32_t>(session->square.add(data, take));
+            data += take;
+            size -= take;
+
+            if (session->elementsLeft == 0) {
+                completeVector(session);
+            }
+            break;
+        }
+        default:
+            // Пакет обработан (или сессия закрыта): остаток игнорируется, как в однопоточном режиме
+            return;
+        }
+    }
+}
+
+void EventLoop::completeVector(Session* session) {
+    int16_t result = session->square.result();
+    // Результаты уходят клиенту по порядку: сначала векторы сессии, ждущие в дорожках
+    if (session->batchedLanes > 0) {
+        flushBatch();
+        if (session->stage == SessionStage::Closing) {
+            return;
+        }
+    }
+    if (storeResult(session, session->vectorSize, result)) {
+        advanceVector(session);
+    }
+}
+
+bool EventLoop::storeResult(Session* session, uint32_t length, int16_t result) {
+    server.metrics.vectorsProcessed++;
+
+    if (session->stage != SessionStage::Closing) {
+        if (!session->outbox) {
+            session->outbox = buffers.acquire();
+            session->outboxHead = 0;
+            session->outboxTail = 0;
+        }
+        if (session->outboxTail + sizeof(result) > BufferPool::kBufferSize) {
+            std::memmove(session->outbox, session->outbox + session->outboxHead,
+                         session->outboxTail - session->outboxHead);
+            session->outboxTail -= session->outboxHead;
+            session->outboxHead = 0;
+        }
+        std::memcpy(session->outbox + session->outboxTail, &result, sizeof(result));
+        session->outboxTail += sizeof(result);
+    }
+
+    if (server.journal) {
+        std::string login(session->login, session->loginLength);
+        uint64_t sequence = server.journal->append(ResultRecord::make(login, length, result));
+        if (sequence == 0) {
+            server.logError("Result journal write failed, result for vector " +
+                            std::to_string(session->vectorIndex + 1) + " not acknowledged", true);
+            closeSession(session);
+            return false;
+        }
+        lastSequence = sequence;
+    }
+    if (server.resultTap) {
+        server.resultTap->publish(ResultRecord::make(std::string(session->login, session->loginLength),
+                                                     length, result));
+    }
+    return true;
+}
+
+void EventLoop::advanceVector(Session* session) {
+    ++session->vectorIndex;
+    if (session->vectorIndex == session->numVectors) {
+        session->stage = SessionStage::Draining;
+        disarmDeadline(session);
+    } else {
+        session->stage = SessionStage::ReadSize;
+    }
+}
+
+void EventLoop::flushBatch() {
+    if (batch.empty()) {
+        return;
+    }
+    batch.compute();
+    server.metrics.microBatches++;
+    server.metrics.microBatchLanes += batch.size();
+
+    // Вектор, принятый закрытой сессией, все равно учитывается в журнале: он получен целиком
+    for (size_t lane = 0; lane < batch.size(); ++lane) {
+        Session* session = batch.owner(lane);
+        if (--session->batchedLanes == 0) {
+            batchOwners.push_back(session);
+        }
+        storeResult(session, batch.length(lane), batch.result(lane));
+    }
+    batch.clear();
+
+    for (Session* session : batchOwners) {
+        if (session->stage != SessionStage::Closing) {
+            deliver(session);
+        }
+    }
+    batchOwners.clear();
+}
+
+void EventLoop::flushOutbox(Session* session) {
+    while (session->outboxHead < session->outboxTail) {
+        ssize_t sent = send(session->fd, session->outbox + session->outboxHead,
+                            session->outboxTail - session->outboxHead, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Клиент не читает: больше не принимаем, пока результаты не уйдут
+            watch(session, true);
+            return;
+        }
+        if (sent <= 0) {
+            server.logError("Failed to send result for vector " + std::to_string(session->vectorIndex), false);
+            cancelSession(session, false);
+            return;
+        }
+        session->outboxHead += static_cast<uint32_t>(sent);
+    }
+
+    buffers.release(session->outbox);
+    session->outbox = nullptr;
+    session->outboxHead = 0;
+    session->outboxTail = 0;
+
+    if (session->stage == SessionStage::Draining && session->batchedLanes == 0) {
+        server.logError("Client connection closed", false);
+        closeSession(session);
+    }
+}
+
+void EventLoop::watch(Session* session, bool writable) {
+    epoll_event event{};
+    event.events = writable ? EPOLLOUT | EPOLLRDHUP : kReadEvents;
+    event.data.ptr = session;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, session->fd, &event);
+}
+
+void EventLoop::closeSession(Session* session) {
+    if (session->stage == SessionStage::Closing) {
+        return;
+    }
+    close(session->fd);
+    session->fd = -1;
+    clearIdle(session);
+    disarmDeadline(session);
+    if (session->keyAwaited) {
+        awaitingKey.erase(std::remove(awaitingKey.begin(), awaitingKey.end(), session), awaitingKey.end());
+    }
+    if (session->outbox) {
+        buffers.release(session->outbox);
+        session->outbox = nullptr;
+    }
+    session->stage = SessionStage::Closing;
+    closing.push_back(session);
+}
@@ -0,0 +1,300 @@
+/**
+ * @file eventloop.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл событийного цикла сервера.
+ * @details Событийный режим обслуживает множество подключений в одном потоке
+ *          через epoll. Протокол тот же, что и в однопоточном режиме, но
+ *          каждое подключение — это конечный автомат Session, а элементы
+ *          векторов суммируются по мере поступления, без буфера на весь вектор.
+ */
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "handoff.h"
+#include "microbatch.h"
+#include "session.h"
+
+class Server;
+class Heartbeat;
+
+/// Емкость очереди подключений, передаваемых циклу другими потоками.
+static const size_t kHandoffCapacity = 1024;
+
+/**
+ * @brief Нагрузка цикла, публикуемая для балансировщика.
+ */
+struct WorkerLoad {
+    std::atomic<uint64_t> busyNs{0};      ///< Суммарное время обработки событий, нс
+    std::atomic<uint32_t> sessions{0};    ///< Открытые подключения
+    std::atomic<uint64_t> readyEvents{0}; ///< Всего событий, полученных от epoll_wait()
+    std::atomic<uint64_t> wakeups{0};     ///< Всего возвратов из epoll_wait() с событиями
+};
+
+/**
+ * @brief Событийный цикл на epoll.
+ */
+class EventLoop {
+public:
+    /**
+     * @brief Конструктор цикла.
+     * @param server Сервер (база пользователей, журнал, логирование).
+     * @param listenSocket Слушающий сокет (-1 — подключения приходят только от других циклов).
+     */
+    EventLoop(Server& server, int listenSocket);
+
+    /**
+     * @brief Деструктор: закрывает дескрипторы epoll и пробуждения.
+     */
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * @brief Запускает цикл обработки событий.
+     * @return false если epoll не удалось создать.
+     */
+    bool run();
+
+    /**
+     * @brief Просит цикл завершиться (из любого потока).
+     * @details run() возвращает true после текущей итерации; открытые
+     *          подключения остаются открытыми.
+     */
+    void stop();
+
+    /**
+     * @brief Возвращает количество открытых подключений.
+     */
+    size_t getSessionCount() const { return sessions.size(); }
+
+    /**
+     * @brief Задает циклы, между которыми по кругу распределяются принятые подключения.
+     * @param loops Все циклы пула, включая этот.
+     */
+    void setPeers(const std::vector<EventLoop*>& loops) { peers = loops; }
+
+    /**
+     * @brief Передает циклу подключение вместе с состоянием (из любого потока).
+     * @param state Состояние сессии; сокет больше не должен отслеживаться отправителем.
+     * @return false если очередь передачи заполнена.
+     */
+    bool adopt(const Session& state);
+
+    /**
+     * @brief Просит цикл отдать подключения другому циклу.
+     * @param target Цикл-получатель.
+     * @param count Сколько подключений передать.
+     * @details Передаются подключения только между пакетами. Простаивающие
+     *          подключения цикл отдает сразу по запросу, остальные — когда
+     *          они дойдут до границы пакета.
+     */
+    void requestMigration(EventLoop* target, uint32_t count);
+
+    /**
+     * @brief Сообщает циклу, что завершен вывод ключа HMAC (из потока вывода ключей).
+     */
+    void hmacKeyDerived();
+
+    /**
+     * @brief Возвращает публикуемую нагрузку цикла.
+     */
+    const WorkerLoad& getLoad() const { return load; }
+
+    /**
+     * @brief Задает имя цикла для сообщений сторожа зависаний.
+     * @param loopName Имя (совпадает с именем потока).
+     */
+    void setName(const std::string& loopName) { name = loopName; }
+
+private:
+    Server& server;                          ///< Владелец цикла
+    int listenSocket;                        ///< Слушающий сокет
+    int epollFd = -1;                        ///< Дескриптор epoll
+    int wakeFd = -1;                         ///< eventfd: подключения в очереди передачи, запрос переноса, ключ HMAC
+    SlabPool<Session> sessions;              ///< Состояния подключений
+    BufferPool buffers;                      ///< Буферы результатов
+    std::vector<uint8_t> scratch;            ///< Общий буфер приема цикла
+    std::vector<Session*> awaitingDurable;   ///< Сессии, ждущие фиксации журнала
+    std::vector<Session*> closing;           ///< Закрытые сессии, освобождаемые в конце итерации
+    uint64_t lastSequence = 0;               ///< Последний номер записи журнала в итерации
+    std::vector<Session*> deadlines;         ///< Сессии с активным сроком пакета
+    int64_t nextMetricsWrite = 0;            ///< Время следующей выгрузки счетчиков, мс
+    std::vector<EventLoop*> peers;           ///< Циклы для распределения принятых подключений
+    size_t nextPeer = 0;                     ///< Следующий цикл по кругу
+    HandoffQueue<Session, kHandoffCapacity> inbox; ///< Подключения от других циклов
+    std::atomic<EventLoop*> migrationTarget{nullptr}; ///< Куда отдавать подключения
+    std::atomic<uint32_t> migrationBudget{0}; ///< Сколько подключений еще отдать
+    std::atomic<bool> migrationRequested{false}; ///< Новый запрос: отдать простаивающие подключения
+    std::vector<Session*> idle;              ///< Сессии между пакетами (кандидаты на перенос)
+    std::atomic<bool> keysDerived{false};    ///< Завершен вывод ключа, который ждут сессии
+    std::vector<Session*> awaitingKey;       ///< Сессии, ждущие вывода ключа HMAC
+    std::atomic<bool> stopping{false};       ///< Запрошено завершение цикла
+    WorkerLoad load;                         ///< Публикуемая нагрузка
+    std::string name = "event-loop";         ///< Имя цикла для сторожа
+    Heartbeat* heartbeat = nullptr;          ///< Пульс цикла (если сторож включен)
+    MicroBatch batch;                        ///< Крошечные векторы, ждущие общего прохода
+    std::vector<Session*> batchOwners;       ///< Сессии, получившие результаты прохода
+
+    /**
+     * @brief Принимает все ожидающие подключения.
+     */
+    void acceptClients();
+
+    /**
+     * @brief Начинает отслеживать сессию (новую или переданную другим циклом).
+     * @return false если сокет не удалось добавить в epoll (сессия закрыта).
+     */
+    bool attach(Session* session);
+
+    /**
+     * @brief Забирает подключения из очереди передачи.
+     */
+    void adoptPending();
+
+    /**
+     * @brief Отдает сессию циклу-получателю, если она на границе пакета.
+     * @return true если сессия передана и больше не принадлежит этому циклу.
+     */
+    bool migrate(Session* session);
+
+    /**
+     * @brief Отдает простаивающие сессии в пределах оставшегося бюджета переноса.
+     */
+    void migrateIdle();
+
+    /**
+     * @brief Добавляет сессию в список простаивающих.
+     */
+    void markIdle(Session* session);
+
+    /**
+     * @brief Убирает сессию из списка простаивающих (если она там есть).
+     */
+    void clearIdle(Session* session);
+
+    /**
+     * @brief Обрабатывает готовность сокета к чтению.
+     */
+    void onReadable(Session* session);
+
+    /**
+     * @brief Обрабатывает готовность сокета к записи.
+     */
+    void onWritable(Session* session);
+
+    /**
+     * @brief Принимает логин и выдает соль.
+     */
+    void handleLogin(Session* session);
+
+    /**
+     * @brief Принимает и проверяет HASH(SALT || PASSWORD).
+     * @details Если ключ HMAC еще выводится, сокет не читается до конца вывода.
+     */
+    void handleHash(Session* session);
+
+    /**
+     * @brief Возобновляет чтение сессий, ключи которых выведены.
+     */
+    void resumeAwaitingKey();
+
+    /**
+     * @brief Разбирает принятые байты пакета векторов.
+     * @param session Сессия.
+     * @param data Принятые байты.
+     * @param size Количество байт.
+     */
+    void consume(Session* session, const uint8_t* data, size_t size);
+
+    /**
+     * @brief Передает результаты сессии клиенту после разбора принятых байт.
+     * @details При строгом журнале сессия ждет групповой фиксации; закончившая
+     *          пакет сессия без неотправленных результатов закрывается.
+     */
+    void deliver(Session* session);
+
+    /**
+     * @brief Завершает вектор: вычисляет результат и кладет его в буфер отправки.
+     */
+    void completeVector(Session* session);
+
+    /**
+     * @brief Кладет результат в буфер отправки, журнал и кольцо результатов.
+     * @param session Сессия (закрытой сессии результат не отправляется).
+     * @param length Количество элементов вектора.
+     * @param result Результат.
+     * @return false если запись в журнал не удалась (сессия закрыта).
+     */
+    bool storeResult(Session* session, uint32_t length, int16_t result);
+
+    /**
+     * @brief Переводит сессию к следующему вектору или к отправке остатка.
+     */
+    void advanceVector(Session* session);
+
+    /**
+     * @brief Считает накопленные крошечные векторы одним проходом и раздает результаты.
+     */
+    void flushBatch();
+
+    /**
+     * @brief Отправляет накопленные результаты.
+     * @details Если сокет не принял все данные, чтение приостанавливается до
+     *          готовности сокета к записи.
+     */
+    void flushOutbox(Session* session);
+
+    /**
+     * @brief Переключает интерес epoll между чтением и записью.
+     */
+    void watch(Session* session, bool writable);
+
+    /**
+     * @brief Закрывает подключение; объект освобождается в конце итерации.
+     */
+    void closeSession(Session* session);
+
+    /**
+     * @brief Отменяет незавершенный пакет сессии и закрывает подключение.
+     * @param session Сессия.
+     * @param deadlineExpired true — истек срок, false — клиент отключился.
+     */
+    void cancelSession(Session* session, bool deadlineExpired);
+
+    /**
+     * @brief Ставит срок пакета на контроль.
+     * @param session Сессия.
+     * @param milliseconds Срок от текущего момента.
+     */
+    void armDeadline(Session* session, uint32_t milliseconds);
+
+    /**
+     * @brief Добавляет сессию с уже заданным deadlineMs в список сроков.
+     */
+    void trackDeadline(Session* session);
+
+    /**
+     * @brief Снимает срок пакета с контроля.
+     */
+    void disarmDeadline(Session* session);
+
+    /**
+     * @brief Отменяет пакеты с истекшим сроком.
+     * @param now Текущее время, мс steady_clock.
+     */
+    void expireDeadlines(int64_t now);
+
+    /**
+     * @brief Возвращает таймаут epoll_wait() с учетом сроков и выгрузки счетчиков.
+     */
+    int pollTimeout() const;
+};
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,91 @@
+/**
+ * @file handoff.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Очередь передачи объектов между потоками без блокировок.
+ * @details Ограниченная кольцевая очередь с номером последовательности в
+ *          каждой ячейке (схема Д. Вьюкова): писатели и читатель
+ *          согласуются только атомарными операциями над номерами, поэтому
+ *          поток, отдающий подключение, никогда не ждет поток, принимающий его.
+ */
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Ограниченная очередь без блокировок (несколько писателей, один читатель).
+ * @tparam T Тип элемента (копируемый).
+ * @tparam Capacity Емкость, степень двойки.
+ */
+template <typename T, size_t Capacity>
+class HandoffQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    HandoffQueue() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    HandoffQueue(const HandoffQueue&) = delete;
+    HandoffQueue& operator=(const HandoffQueue&) = delete;
+
+    /**
+     * @brief Кладет элемент в очередь (вызывается из любого потока).
+     * @param value Элемент.
+     * @return false если очередь заполнена.
+     */
+    bool push(const T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & (Capacity - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Забирает элемент из очереди (только поток-владелец).
+     * @param value Принятый элемент.
+     * @return false если очередь пуста.
+     */
+    bool pop(T& value) {
+        Cell& cell = cells[head & (Capacity - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(head + 1) < 0) {
+            return false;
+        }
+        value = cell.value;
+        cell.sequence.store(head + Capacity, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence; ///< Номер, при котором ячейка доступна писателю/читателю
+        T value;                      ///< Элемент
+    };
+
+    Cell cells[Capacity];                  ///< Кольцо ячеек
+    alignas(64) std::atomic<size_t> tail{0}; ///< Следующая позиция записи
+    alignas(64) size_t head = 0;             ///< Следующая позиция чтения (только читатель)
+};
+
+#endif // HANDOFF_H
@@ -0,0 +1,176 @@
+/**
+ * @file hmacauth.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация аутентификации HMAC-SHA224.
+ */
+
+#include "hmacauth.h"
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+/// Размер блока SHA-224, байт.
+static const size_t kBlockSize = 64;
+
+/**
+ * @brief Освобождает контекст OpenSSL в unique_ptr.
+ */
+struct ContextDeleter {
+    void operator()(EVP_MD_CTX* context) const { EVP_MD_CTX_free(context); }
+};
+
+/**
+ * @brief Возвращает рабочий контекст потока, в который копируются подготовленные состояния.
+ */
+static EVP_MD_CTX* scratchContext() {
+    thread_local std::unique_ptr<EVP_MD_CTX, ContextDeleter> context(EVP_MD_CTX_new());
+    return context.get();
+}
+
+static std::string toHex(const unsigned char* data, size_t size) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; ++i) {
+        hex[2 * i] = digits[data[i] >> 4];
+        hex[2 * i + 1] = digits[data[i] & 0x0F];
+    }
+    return hex;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+std::string deriveHmacKey(const std::string& login, const std::string& password) {
+    unsigned char key[kHmacKeySize];
+    if (PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()),
+                          reinterpret_cast<const unsigned char*>(login.data()), static_cast<int>(login.size()),
+                          kKeyDerivationIterations, EVP_sha224(), sizeof(key), key) != 1) {
+        return "";
+    }
+    return std::string(reinterpret_cast<const char*>(key), sizeof(key));
+}
+
+bool parseDerivedKey(const std::string& entry, std::string& key) {
+    size_t prefixLength = sizeof(kDerivedKeyPrefix) - 1;
+    if (entry.size() != prefixLength + 2 * kHmacKeySize || entry.compare(0, prefixLength, kDerivedKeyPrefix) != 0) {
+        return false;
+    }
+    key.assign(kHmacKeySize, '\0');
+    for (size_t i = 0; i < kHmacKeySize; ++i) {
+        int high = hexValue(entry[prefixLength + 2 * i]);
+        int low = hexValue(entry[prefixLength + 2 * i + 1]);
+        if (high < 0 || low < 0) {
+            key.clear();
+            return false;
+        }
+        key[i] = static_cast<char>(high << 4 | low);
+    }
+    return true;
+}
+
+std::string derivedKeyEntry(const std::string& login, const std::string& password) {
+    std::string key = deriveHmacKey(login, password);
+    return login + ":" + kDerivedKeyPrefix + toHex(reinterpret_cast<const unsigned char*>(key.data()), key.size());
+}
+
+HmacKey::~HmacKey() {
+    EVP_MD_CTX_free(inner);
+    EVP_MD_CTX_free(outer);
+}
+
+HmacKey::HmacKey(HmacKey&& other) noexcept : inner(other.inner), outer(other.outer) {
+    other.inner = nullptr;
+    other.outer = nullptr;
+}
+
+HmacKey& HmacKey::operator=(HmacKey&& other) noexcept {
+    if (this != &other) {
+        std::swap(inner, other.inner);
+        std::swap(outer, other.outer);
+    }
+    return *this;
+}
+
+bool HmacKey::init(const std::string& key) {
+    unsigned char block[kBlockSize] = {0};
+    if (key.size() > kBlockSize) {
+        unsigned int length = 0;
+        if (EVP_Digest(key.data(), key.size(), block, &length, EVP_sha224(), nullptr) != 1) {
+            return false;
+        }
+    } else {
+        std::copy(key.begin(), key.end(), block);
+    }
+
+    unsigned char innerPad[kBlockSize];
+    unsigned char outerPad[kBlockSize];
+    for (size_t i = 0; i < kBlockSize; ++i) {
+        innerPad[i] = block[i] ^ 0x36;
+        outerPad[i] = block[i] ^ 0x5c;
+    }
+
+    if (!inner) {
+        inner = EVP_MD_CTX_new();
+    }
+    if (!outer) {
+        outer = EVP_MD_CTX_new();
+    }
+    return inner && outer &&
+           EVP_DigestInit_ex(inner, EVP_sha224(), nullptr) == 1 &&
+           EVP_DigestUpdate(inner, innerPad, sizeof(innerPad)) == 1 &&
+           EVP_DigestInit_ex(outer, EVP_sha224(), nullptr) == 1 &&
+           EVP_DigestUpdate(outer, outerPad, sizeof(outerPad)) == 1;
+}
+
+bool HmacKey::compute(const std::string& message, unsigned char* digest) const {
+    EVP_MD_CTX* context = scratchContext();
+    if (!inner || !outer || !context) {
+        return false;
+    }
+    unsigned char innerDigest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    return EVP_MD_CTX_copy_ex(context, inner) == 1 &&
+           EVP_DigestUpdate(context, message.data(), message.size()) == 1 &&
+           EVP_DigestFinal_ex(context, innerDigest, &length) == 1 &&
+           EVP_MD_CTX_copy_ex(context, outer) == 1 &&
+           EVP_DigestUpdate(context, innerDigest, length) == 1 &&
+           EVP_DigestFinal_ex(context, digest, &length) == 1 && length == kHmacKeySize;
+}
+
+std::string HmacKey::sign(const std::string& message) const {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    if (!compute(message, digest)) {
+        return "";
+    }
+    return toHex(digest, kHmacKeySize);
+}
+
+bool HmacKey::verify(const std::string& message, const std::string& receivedHex) const {
+    if (receivedHex.size() != 2 * kHmacKeySize) {
+        return false;
+    }
+    unsigned char received[kHmacKeySize];
+    for (size_t i = 0; i < kHmacKeySize; ++i) {
+        int high = hexValue(receivedHex[2 * i]);
+        int low = hexValue(receivedHex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        received[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    return compute(message, digest) && CRYPTO_memcmp(digest, received, kHmacKeySize) == 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file hmacauth.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Аутентификация HMAC-SHA224 с заранее подготовленными ключами.
+ * @details Клиент выбирает режим, передавая логин с префиксом "HMAC:", и
+ *          отвечает на соль значением HMAC-SHA224(K, SALT), где
+ *          K = PBKDF2-HMAC-SHA224(пароль, логин). Для каждого пользователя при
+ *          загрузке базы поглощаются блоки K ^ ipad и K ^ opad, поэтому
+ *          проверка ответа стоит двух вызовов функции сжатия. В базе вместо
+ *          пароля может храниться сам ключ: "логин:$k$<hex>".
+ */
+
+#ifndef HMACAUTH_H
+#define HMACAUTH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+/// Префикс логина, выбирающий аутентификацию HMAC.
+static const char kHmacLoginPrefix[] = "HMAC:";
+
+/// Префикс записи базы, хранящей ключ вместо пароля.
+static const char kDerivedKeyPrefix[] = "$k$";
+
+/// Итерации PBKDF2 при выводе ключа из пароля.
+static const int kKeyDerivationIterations = 4096;
+
+/// Длина ключа и ответа HMAC-SHA224, байт.
+static const size_t kHmacKeySize = 28;
+
+/**
+ * @brief Выводит ключ HMAC пользователя из пароля.
+ * @param login Логин (соль PBKDF2).
+ * @param password Пароль.
+ * @return Ключ (kHmacKeySize байт) или пустая строка при ошибке.
+ */
+std::string deriveHmacKey(const std::string& login, const std::string& password);
+
+/**
+ * @brief Проверяет, хранит ли запись базы ключ вместо пароля.
+ */
+inline bool isDerivedKeyEntry(const std::string& entry) {
+    return entry.compare(0, sizeof(kDerivedKeyPrefix) - 1, kDerivedKeyPrefix) == 0;
+}
+
+/**
+ * @brief Разбирает запись "$k$<hex>".
+ * @param entry Поле пароля из базы.
+ * @param key Ключ (пустой при ошибке).
+ * @return false если запись не является корректным ключом.
+ */
+bool parseDerivedKey(const std::string& entry, std::string& key);
+
+/**
+ * @brief Отделяет от логина префикс режима HMAC.
+ * @param login Принятый логин (префикс удаляется).
+ * @return true если клиент выбрал режим HMAC.
+ */
+inline bool takeHmacPrefix(std::string& login) {
+    size_t prefixLength = sizeof(kHmacLoginPrefix) - 1;
+    if (login.compare(0, prefixLength, kHmacLoginPrefix) != 0) {
+        return false;
+    }
+    login.erase(0, prefixLength);
+    return true;
+}
+
+/**
+ * @brief Формирует запись базы пользователей с выведенным ключом.
+ * @return Строка "логин:$k$<hex>".
+ */
+std::string derivedKeyEntry(const std::string& login, const std::string& password);
+
+/**
+ * @brief Подготовленный ключ HMAC-SHA224 одного пользователя.
+ */
+class HmacKey {
+public:
+    HmacKey() = default;
+    ~HmacKey();
+
+    HmacKey(HmacKey&& other) noexcept;
+    HmacKey& operator=(HmacKey&& other) noexcept;
+    HmacKey(const HmacKey&) = delete;
+    HmacKey& operator=(const HmacKey&) = delete;
+
+    /**
+     * @brief Поглощает блоки K ^ ipad и K ^ opad.
+     * @param key Ключ (не длиннее блока SHA-224).
+     * @return false при ошибке OpenSSL.
+     */
+    bool init(const std::string& key);
+
+    /**
+     * @brief Вычисляет HMAC сообщения.
+     * @return 56 шестнадцатеричных символов в верхнем регистре (пусто при ошибке).
+     */
+    std::string sign(const std::string& message) const;
+
+    /**
+     * @brief Проверяет ответ клиента за постоянное время.
+     * @param message Выданная соль.
+     * @param receivedHex Ответ клиента (hex в любом регистре).
+     */
+    bool verify(const std::string& message, const std::string& receivedHex) const;
+
+private:
+    EVP_MD_CTX* inner = nullptr; ///< Состояние после блока K ^ ipad
+    EVP_MD_CTX* outer = nullptr; ///< Состояние после блока K ^ opad
+
+    /**
+     * @brief Вычисляет HMAC в двоичном виде.
+     * @param digest Буфер на kHmacKeySize байт.
+     */
+    bool compute(const std::string& message, unsigned char* digest) const;
+};
+
+#endif // HMACAUTH_H
@@ -0,0 +1,253 @@
+/**
+ * @file hugepages.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация переноса кода и горячих данных на большие страницы.
+ */
+
+#include "hugepages.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/// Начало области больших страниц для горячих таблиц.
+static std::atomic<uintptr_t> heapBegin{0};
+
+/// Конец области.
+static std::atomic<uintptr_t> heapEnd{0};
+
+/// Первый свободный адрес области.
+static std::atomic<uintptr_t> heapNext{0};
+
+static uintptr_t alignUp(uintptr_t value, uintptr_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uintptr_t alignDown(uintptr_t value, uintptr_t alignment) {
+    return value & ~(alignment - 1);
+}
+
+/**
+ * @brief Возвращает объем больших страниц в отображении, начинающемся с адреса.
+ * @details Читает поле AnonHugePages из /proc/self/smaps.
+ */
+static size_t hugeBytesAt(uintptr_t begin) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::ostringstream prefix;
+    prefix << std::hex << begin << "-";
+    std::string wanted = prefix.str();
+
+    std::string line;
+    bool inMapping = false;
+    while (std::getline(smaps, line)) {
+        // Заголовок отображения: "начало-конец права ..."; строки полей: "Имя: значение"
+        size_t space = line.find(' ');
+        if (line.find('-') < space && line.find(':') > space) {
+            inMapping = line.compare(0, wanted.size(), wanted) == 0;
+        } else if (inMapping && line.compare(0, 14, "AnonHugePages:") == 0) {
+            return std::stoull(line.substr(14)) * 1024;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Проверяет, что в диапазоне адресов нет отображений.
+ * @details Пробное отображение с MAP_FIXED_NOREPLACE; ядра без этого флага
+ *          воспринимают адрес как подсказку, и диапазон считается занятым.
+ */
+static bool addressRangeFree(uintptr_t begin, uintptr_t end) {
+    void* probe = mmap(reinterpret_cast<void*>(begin), end - begin, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (probe == MAP_FAILED) {
+        return false;
+    }
+    munmap(probe, end - begin);
+    return probe == reinterpret_cast<void*>(begin);
+}
+
+/**
+ * @brief Отображает анонимную память, выровненную по большой странице.
+ * @return Адрес или 0 при ошибке.
+ */
+static uintptr_t mapAligned(size_t length) {
+    void* raw = mmap(nullptr, length + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return 0;
+    }
+    uintptr_t rawBegin = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t begin = alignUp(rawBegin, kHugePageSize);
+    if (begin > rawBegin) {
+        munmap(raw, begin - rawBegin);
+    }
+    uintptr_t rawEnd = rawBegin + length + kHugePageSize;
+    if (rawEnd > begin + length) {
+        munmap(reinterpret_cast<void*>(begin + length), rawEnd - (begin + length));
+    }
+    madvise(reinterpret_cast<void*>(begin), length, MADV_HUGEPAGE);
+    return begin;
+}
+
+/**
+ * @brief Переносит сегмент [begin, end) на большие страницы.
+ * @param segment Имя сегмента для отчета.
+ * @param protection Права доступа сегмента.
+ */
+static HugePageRemap remapSegment(const char* segment, uintptr_t begin, uintptr_t end, int protection) {
+    HugePageRemap result;
+    result.segment = segment;
+
+    uintptr_t regionBegin = alignUp(begin, kHugePageSize);
+    uintptr_t regionEnd = alignUp(end, kHugePageSize);
+    uintptr_t pageEnd = alignUp(end, static_cast<uintptr_t>(getpagesize()));
+    if (regionEnd > pageEnd && !addressRangeFree(pageEnd, regionEnd)) {
+        regionEnd = alignDown(end, kHugePageSize);
+    }
+    if (regionEnd <= regionBegin) {
+        result.reason = "segment does not span a whole huge page";
+        return result;
+    }
+    size_t length = regionEnd - regionBegin;
+
+    // Копия собирается в стороне: исходный сегмент остается на месте, пока выполняется этот код
+    uintptr_t staging = mapAligned(length);
+    if (staging == 0) {
+        result.reason = std::string("mmap failed: ") + strerror(errno);
+        return result;
+    }
+    std::memcpy(reinterpret_cast<void*>(staging), reinterpret_cast<const void*>(regionBegin),
+                std::min(end, regionEnd) - regionBegin);
+    if (hugeBytesAt(staging) == 0) {
+        munmap(reinterpret_cast<void*>(staging), length);
+        result.reason = "kernel did not provide huge pages";
+        return result;
+    }
+    mprotect(reinterpret_cast<void*>(staging), length, protection);
+
+    // mremap() заменяет отображение за один системный вызов: без окна, в котором кода нет
+    void* moved = mremap(reinterpret_cast<void*>(staging), length, length, MREMAP_MAYMOVE | MREMAP_FIXED,
+                         reinterpret_cast<void*>(regionBegin));
+    if (moved == MAP_FAILED) {
+        result.reason = std::string("mremap failed: ") + strerror(errno);
+        munmap(reinterpret_cast<void*>(staging), length);
+        return result;
+    }
+    result.remapped = true;
+    result.bytes = hugeBytesAt(regionBegin);
+    return result;
+}
+
+/**
+ * @brief Границы сегментов исполняемого файла.
+ */
+struct ExecutableSegments {
+    uintptr_t textBegin = 0;
+    uintptr_t textEnd = 0;
+    uintptr_t rodataBegin = 0;
+    uintptr_t rodataEnd = 0;
+};
+
+/**
+ * @brief Находит исполняемый сегмент и следующий за ним сегмент только для чтения.
+ * @details dl_iterate_phdr() первым передает сам исполняемый файл.
+ */
+static int findSegments(dl_phdr_info* info, size_t, void* data) {
+    ExecutableSegments* segments = static_cast<ExecutableSegments*>(data);
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr)& header = info->dlpi_phdr[i];
+        if (header.p_type != PT_LOAD) {
+            continue;
+        }
+        uintptr_t begin = info->dlpi_addr + header.p_vaddr;
+        uintptr_t end = begin + header.p_memsz;
+        if (header.p_flags & PF_X) {
+            segments->textBegin = begin;
+            segments->textEnd = end;
+        } else if (segments->textEnd != 0 && segments->rodataEnd == 0 && header.p_flags == PF_R) {
+            segments->rodataBegin = begin;
+            segments->rodataEnd = end;
+        }
+    }
+    return 1;
+}
+
+bool transparentHugePagesEnabled() {
+    std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string modes;
+    std::getline(file, modes);
+    return !modes.empty() && modes.find("[never]") == std::string::npos;
+}
+
+std::vector<HugePageRemap> remapExecutableToHugePages() {
+    std::vector<HugePageRemap> results;
+    if (!transparentHugePagesEnabled()) {
+        HugePageRemap result;
+        result.segment = "text";
+        result.reason = "transparent huge pages are disabled";
+        results.push_back(result);
+        return results;
+    }
+
+    ExecutableSegments segments;
+    dl_iterate_phdr(findSegments, &segments);
+    if (segments.textEnd == 0) {
+        HugePageRemap result;
+        result.segment = "text";
+        result.reason = "executable segment not found";
+        results.push_back(result);
+        return results;
+    }
+    results.push_back(remapSegment("text", segments.textBegin, segments.textEnd, PROT_READ | PROT_EXEC));
+    if (segments.rodataEnd != 0) {
+        results.push_back(remapSegment("rodata", segments.rodataBegin, segments.rodataEnd, PROT_READ));
+    }
+    return results;
+}
+
+bool reserveHugePageHeap(size_t bytes) {
+    if (heapBegin.load() != 0 || !transparentHugePagesEnabled()) {
+        return false;
+    }
+    size_t length = alignUp(bytes, kHugePageSize);
+    uintptr_t begin = mapAligned(length);
+    if (begin == 0) {
+        return false;
+    }
+    heapNext = begin;
+    heapEnd = begin + length;
+    heapBegin = begin;
+    return true;
+}
+
+void* hugePageAllocate(size_t bytes, size_t alignment) {
+    if (heapBegin.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+    uintptr_t next = heapNext.load(std::memory_order_relaxed);
+    uintptr_t begin;
+    do {
+        begin = alignUp(next, alignment);
+        if (begin + bytes > heapEnd.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+    } while (!heapNext.compare_exchange_weak(next, begin + bytes, std::memory_order_relaxed));
+    return reinterpret_cast<void*>(begin);
+}
+
+bool hugePageOwns(const void* pointer) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+    uintptr_t begin = heapBegin.load(std::memory_order_acquire);
+    return begin != 0 && address >= begin && address < heapEnd.load(std::memory_order_relaxed);
+}
+
+size_t hugePageHeapUsed() {
+    uintptr_t begin = heapBegin.load(std::memory_order_acquire);
+    return begin == 0 ? 0 : heapNext.load(std::memory_order_relaxed) - begin;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file hugepages.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Размещение кода и горячих данных сервера на больших страницах.
+ * @details Исполняемый сегмент и следующий за ним сегмент данных только для
+ *          чтения копируются в анонимную память с MADV_HUGEPAGE и одним
+ *          вызовом mremap() подменяют исходное отображение файла: код
+ *          продолжает выполняться по тем же адресам, но занимает записи
+ *          iTLB для страниц 2 МиБ вместо сотен записей для 4 КиБ. Горячие
+ *          таблицы (база пользователей) размещаются в отдельной области из
+ *          больших страниц. Если ядро не выделяет большие страницы, все
+ *          остается как было.
+ */
+
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+/// Размер прозрачной большой страницы (x86-64).
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+/**
+ * @brief Итог переноса одного сегмента.
+ */
+struct HugePageRemap {
+    const char* segment = ""; ///< Имя сегмента (text, rodata)
+    size_t bytes = 0;         ///< Байт на больших страницах после переноса
+    bool remapped = false;    ///< Сегмент перенесен
+    std::string reason;       ///< Почему сегмент остался на обычных страницах
+};
+
+/**
+ * @brief Проверяет, разрешены ли прозрачные большие страницы (не "never").
+ */
+bool transparentHugePagesEnabled();
+
+/**
+ * @brief Переносит код и данные только для чтения исполняемого файла на большие страницы.
+ * @return Итог по каждому сегменту.
+ * @details Переносятся только целые страницы 2 МиБ; хвост сегмента
+ *          дополняется до страницы, если за ним нет других отображений
+ *          (сервер собирается с -z max-page-size=2 МиБ, чтобы сегменты
+ *          начинались на границе большой страницы).
+ */
+std::vector<HugePageRemap> remapExecutableToHugePages();
+
+/**
+ * @brief Резервирует область больших страниц для горячих таблиц.
+ * @param bytes Размер области (округляется до большой страницы).
+ * @return false если область не выделена (таблицы остаются в обычной куче).
+ */
+bool reserveHugePageHeap(size_t bytes);
+
+/**
+ * @brief Выделяет память из области больших страниц.
+ * @return nullptr если область не зарезервирована или исчерпана.
+ */
+void* hugePageAllocate(size_t bytes, size_t alignment);
+
+/**
+ * @brief Проверяет, принадлежит ли адрес области больших страниц.
+ */
+bool hugePageOwns(const void* pointer);
+
+/**
+ * @brief Возвращает объем занятой части области больших страниц.
+ */
+size_t hugePageHeapUsed();
+
+/**
+ * @brief Распределитель для таблиц, которые заполняются при запуске и затем только читаются.
+ * @details Память берется из области больших страниц, а когда ее нет —
+ *          из обычной кучи. Освобожденные в области блоки не переиспользуются.
+ */
+template <typename T>
+struct HugePageAllocator {
+    using value_type = T;
+
+    HugePageAllocator() = default;
+
+    template <typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        void* pointer = hugePageAllocate(count * sizeof(T), alignof(T));
+        return static_cast<T*>(pointer ? pointer : ::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t) {
+        if (!hugePageOwns(pointer)) {
+            ::operator delete(pointer);
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return false; }
+
+#endif // HUGEPAGES_H
@@ -0,0 +1,145 @@
+/**
+ * @file journal.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация журнала результатов с групповой фиксацией.
+ */
+
+#include "journal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+ResultRecord ResultRecord::make(const std::string& user, uint32_t length, int16_t value) {
+    ResultRecord record;
+    std::memset(&record, 0, sizeof(record));
+    std::memcpy(record.login, user.data(), std::min(user.size(), sizeof(record.login) - 1));
+    record.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.vectorLength = length;
+    record.result = value;
+    return record;
+}
+
+/**
+ * @brief Конструктор журнала.
+ * @param path Путь к файлу журнала.
+ * @param commitIntervalUs Окно сбора группы, мкс.
+ * @param maxBatch Размер группы для досрочной фиксации.
+ */
+ResultJournal::ResultJournal(const std::string& path, int commitIntervalUs, size_t maxBatch)
+    : path(path), commitIntervalUs(commitIntervalUs), maxBatch(maxBatch == 0 ? 1 : maxBatch) {}
+
+ResultJournal::~ResultJournal() {
+    close();
+}
+
+bool ResultJournal::open() {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        return false;
+    }
+    pending.reserve(maxBatch);
+    writer = std::thread(&ResultJournal::writerLoop, this);
+    return true;
+}
+
+uint64_t ResultJournal::append(const ResultRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (failed) {
+        return 0;
+    }
+    pending.push_back(record);
+    uint64_t sequence = ++appended;
+    // Писатель будится на первой записи группы и при заполнении группы
+    if (pending.size() == 1 || pending.size() >= maxBatch) {
+        wakeWriter.notify_one();
+    }
+    return sequence;
+}
+
+bool ResultJournal::waitDurable(uint64_t sequence) {
+    if (durable.load(std::memory_order_acquire) >= sequence) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    wakeWaiters.wait(lock, [this, sequence] {
+        return failed || durable.load(std::memory_order_acquire) >= sequence;
+    });
+    return durable.load(std::memory_order_acquire) >= sequence;
+}
+
+void ResultJournal::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void ResultJournal::writerLoop() {
+    std::vector<ResultRecord> batch;
+    batch.reserve(maxBatch);
+
+    while (true) {
+        uint64_t last;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWriter.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+
+            // Окно группы: ждем других сессий, пока группа не заполнится
+            wakeWriter.wait_for(lock, std::chrono::microseconds(commitIntervalUs), [this] {
+                return stopping || pending.size() >= maxBatch;
+            });
+
+            batch.swap(pending);
+            last = appended;
+        }
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(batch.data());
+        size_t remaining = batch.size() * sizeof(ResultRecord);
+        bool ok = true;
+        while (remaining > 0) {
+            ssize_t written = ::write(fd, data, remaining);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                ok = false;
+                break;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        ok = ok && fdatasync(fd) == 0;
+        batch.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                durable.store(last, std::memory_order_release);
+                commits.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                failed = true;
+            }
+        }
+        wakeWaiters.notify_all();
+
+        if (!ok) {
+            return;
+        }
+    }
+}
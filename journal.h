@@ -0,0 +1,125 @@
+/**
+ * @file journal.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл журнала результатов с групповой фиксацией.
+ * @details Каждый вычисленный результат дописывается в журнал отдельным
+ *          потоком-писателем: записи всех сессий собираются в группу и
+ *          фиксируются одним вызовом fdatasync().
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Запись о вычисленном результате (фиксированный двоичный формат, 48 байт).
+ */
+struct ResultRecord {
+    char login[32];          ///< Логин пользователя, дополненный нулями
+    int64_t timestampNs;     ///< Время вычисления, нс от эпохи UNIX
+    uint32_t vectorLength;   ///< Количество элементов вектора
+    int16_t result;          ///< Сумма квадратов
+    uint16_t reserved;       ///< Выравнивание (нули)
+
+    /**
+     * @brief Заполняет запись текущим временем.
+     * @param user Логин (обрезается до 31 символа).
+     * @param length Длина вектора.
+     * @param value Результат.
+     * @return Готовая запись.
+     */
+    static ResultRecord make(const std::string& user, uint32_t length, int16_t value);
+};
+
+static_assert(sizeof(ResultRecord) == 48, "ResultRecord layout is part of the journal format");
+
+/**
+ * @brief Журнал результатов только на дозапись с групповой фиксацией.
+ */
+class ResultJournal {
+public:
+    /**
+     * @brief Конструктор журнала.
+     * @param path Путь к файлу журнала.
+     * @param commitIntervalUs Сколько писатель ждет пополнения группы после первой записи.
+     * @param maxBatch Размер группы, при котором она фиксируется, не дожидаясь конца окна.
+     */
+    ResultJournal(const std::string& path, int commitIntervalUs = 2000, size_t maxBatch = 1024);
+
+    /**
+     * @brief Деструктор: фиксирует оставшиеся записи и останавливает писателя.
+     */
+    ~ResultJournal();
+
+    ResultJournal(const ResultJournal&) = delete;
+    ResultJournal& operator=(const ResultJournal&) = delete;
+
+    /**
+     * @brief Открывает файл и запускает поток-писатель.
+     * @return false если файл не открылся.
+     */
+    bool open();
+
+    /**
+     * @brief Ставит запись в очередь на фиксацию.
+     * @param record Запись о результате.
+     * @return Порядковый номер записи (для waitDurable) или 0, если журнал
+     *         перестал принимать записи из-за ошибки записи на диск.
+     */
+    uint64_t append(const ResultRecord& record);
+
+    /**
+     * @brief Ждет, пока запись с данным номером окажется на диске.
+     * @param sequence Номер, возвращенный append().
+     * @return true если запись зафиксирована, false при ошибке записи журнала.
+     */
+    bool waitDurable(uint64_t sequence);
+
+    /**
+     * @brief Фиксирует все записи и останавливает писателя.
+     */
+    void close();
+
+    /**
+     * @brief Возвращает количество выполненных fdatasync().
+     */
+    uint64_t getCommitCount() const { return commits.load(); }
+
+    /**
+     * @brief Возвращает количество зафиксированных записей.
+     */
+    uint64_t getDurableCount() const { return durable.load(); }
+
+private:
+    std::string path;                  ///< Путь к файлу журнала
+    int commitIntervalUs;              ///< Окно сбора группы, мкс
+    size_t maxBatch;                   ///< Размер группы для досрочной фиксации
+    int fd = -1;                       ///< Дескриптор файла журнала
+
+    std::mutex mutex;                  ///< Защищает pending, appended, stopping, failed
+    std::condition_variable wakeWriter;    ///< Пробуждение писателя
+    std::condition_variable wakeWaiters;   ///< Оповещение о фиксации группы
+    std::vector<ResultRecord> pending; ///< Записи, ожидающие фиксации
+    uint64_t appended = 0;             ///< Номер последней поставленной записи
+    bool stopping = false;             ///< Запрошена остановка
+    bool failed = false;               ///< Ошибка записи: фиксация невозможна
+
+    std::atomic<uint64_t> durable{0};  ///< Номер последней зафиксированной записи
+    std::atomic<uint64_t> commits{0};  ///< Количество групп (fdatasync)
+    std::thread writer;                ///< Поток-писатель
+
+    /**
+     * @brief Основной цикл потока-писателя.
+     */
+    void writerLoop();
+};
+
+#endif // JOURNAL_H
@@ -9,7 +9,15 @@
 
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <memory>
 #include "server.h"
+#include "journal.h"
+#include "resulttap.h"
+#include "tls.h"
+#include "hmacauth.h"
+#include "microbatch.h"
 
 /**
  * @brief Выводит справочную информацию о параметрах командной строки.
@@ -19,9 +27,32 @@ void showHelp() {
     std::cout << "Usage: server [OPTIONS]\n"
               << "Options:\n"
               << "  -h              Show this help\n"
+              << "  -D LOGIN:PASS   Print a user database line with a derived HMAC key and exit\n"
               << "  -p PORT         Port number (default: 33333)\n"
               << "  -c CONFIG_FILE  User database file (default: /scale.conf)\n"
-              << "  -l LOG_FILE     Log file (default: /log/scale.log)\n";
+              << "  -l LOG_FILE     Log file (default: /log/scale.log)\n"
+              << "  -e              Event-driven mode: serve many connections concurrently (epoll)\n"
+              << "  -w WORKERS      Worker threads for event-driven mode (default: 1)\n"
+              << "  -R MILLISECONDS Rebalance connections between workers every N ms, 0 disables (default: 100)\n"
+              << "  -b LANES        Event-driven mode: compute vectors of up to 8 elements from many\n"
+              << "                  connections in shared passes of N lanes, 0 disables (default: 0)\n"
+              << "  -t MICROSECONDS Longest wait for a shared pass to fill (default: 20)\n"
+              << "  -f FD           Use inherited listening socket FD instead of binding\n"
+              << "                  (systemd LISTEN_FDS is detected automatically)\n"
+              << "  -j JOURNAL_FILE Durable result journal (default: disabled)\n"
+              << "  -S              Strict journal: acknowledge results only once durable\n"
+              << "  -T MICROSECONDS Journal group commit interval (default: 2000)\n"
+              << "  -N RECORDS      Journal group size that commits immediately (default: 1024)\n"
+              << "  -r SHM_NAME     Publish results to a shared-memory ring (mode 0640) for local consumers (e.g. /scale-results)\n"
+              << "  -O              Replace a result ring left behind by a crashed server\n"
+              << "  -k              Keep kernel default socket buffers (no per-client sizing)\n"
+              << "  -W MILLISECONDS Report loops busy longer than N ms with a stack trace (default: 0, off);\n"
+              << "                  a sequential session blocked on a silent client also counts as busy\n"
+              << "  -H              Remap code and the user table onto 2 MiB transparent huge pages\n"
+              << "  -M METRICS_FILE Export counters to file (default: disabled)\n"
+              << "  -C CERT_FILE    Enable TLS with this PEM certificate (requires -K)\n"
+              << "  -K KEY_FILE     PEM private key for TLS\n"
+              << "  -U              TLS encryption in user space only (disable kernel TLS)\n";
 }
 
 /**
@@ -36,6 +67,25 @@ int main(int argc, char* argv[]) {
     int port = 33333;
     std::string configFile = "/scale.conf";
     std::string logFile = "/log/scale.log";
+    int listenFd = Server::socketActivationFd();
+    std::string journalFile;
+    std::string tapName;
+    bool replaceTap = false;
+    bool journalStrict = false;
+    int commitInterval = 2000;
+    int commitBatch = 1024;
+    bool eventDriven = false;
+    bool socketTuning = true;
+    bool hugePages = false;
+    int workers = 1;
+    int rebalanceInterval = 100;
+    int batchLanes = 0;
+    int batchWindow = kDefaultBatchWindowUs;
+    int stallThreshold = 0;
+    std::string metricsFile;
+    std::string certFile;
+    std::string keyFile;
+    bool kernelTls = true;
     
     // Если нет аргументов или есть -h, показываем справку и выходим
     for (int i = 1; i < argc; ++i) {
@@ -63,10 +113,103 @@ int main(int argc, char* argv[]) {
                 std::cerr << "Invalid port number: " << argv[i] << std::endl;
                 return 1;
             }
+        } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+            // Запись базы без пароля: такой пользователь входит только в режиме HMAC
+            std::string entry = argv[++i];
+            size_t colon = entry.find(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == entry.size()) {
+                std::cerr << "Expected LOGIN:PASSWORD" << std::endl;
+                return 1;
+            }
+            std::cout << derivedKeyEntry(entry.substr(0, colon), entry.substr(colon + 1)) << std::endl;
+            return 0;
         } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
             configFile = argv[++i];
         } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
             logFile = argv[++i];
+        } else if (strcmp(argv[i], "-e") == 0) {
+            eventDriven = true;
+        } else if ((strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-R") == 0) && i + 1 < argc) {
+            bool isWorkers = argv[i][1] == 'w';
+            try {
+                int value = std::stoi(argv[++i]);
+                if (value < (isWorkers ? 1 : 0)) {
+                    std::cerr << "Invalid worker setting: " << value << std::endl;
+                    return 1;
+                }
+                (isWorkers ? workers : rebalanceInterval) = value;
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid worker setting: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if ((strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "-t") == 0) && i + 1 < argc) {
+            bool isLanes = argv[i][1] == 'b';
+            try {
+                int value = std::stoi(argv[++i]);
+                if (value < 0 || (isLanes && value > static_cast<int>(kMaxBatchLanes))) {
+                    std::cerr << "Invalid batching setting: " << value << std::endl;
+                    return 1;
+                }
+                (isLanes ? batchLanes : batchWindow) = value;
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid batching setting: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            try {
+                listenFd = std::stoi(argv[++i]);
+                if (listenFd < 0) {
+                    std::cerr << "Invalid descriptor: " << listenFd << std::endl;
+                    return 1;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid descriptor: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            journalFile = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            tapName = argv[++i];
+        } else if (strcmp(argv[i], "-O") == 0) {
+            replaceTap = true;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            socketTuning = false;
+        } else if (strcmp(argv[i], "-H") == 0) {
+            hugePages = true;
+        } else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc) {
+            try {
+                stallThreshold = std::stoi(argv[++i]);
+                if (stallThreshold < 0) {
+                    std::cerr << "Invalid stall threshold: " << stallThreshold << std::endl;
+                    return 1;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid stall threshold: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            certFile = argv[++i];
+        } else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) {
+            keyFile = argv[++i];
+        } else if (strcmp(argv[i], "-U") == 0) {
+            kernelTls = false;
+        } else if (strcmp(argv[i], "-S") == 0) {
+            journalStrict = true;
+        } else if ((strcmp(argv[i], "-T") == 0 || strcmp(argv[i], "-N") == 0) && i + 1 < argc) {
+            bool isInterval = argv[i][1] == 'T';
+            try {
+                int value = std::stoi(argv[++i]);
+                if (value < (isInterval ? 0 : 1)) {
+                    std::cerr << "Invalid journal setting: " << value << std::endl;
+                    return 1;
+                }
+                (isInterval ? commitInterval : commitBatch) = value;
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid journal setting: " << argv[i] << std::endl;
+                return 1;
+            }
         } else {
             std::cerr << "Unknown option: " << argv[i] << std::endl;
             showHelp();
@@ -74,9 +217,73 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (certFile.empty() != keyFile.empty()) {
+        std::cerr << "TLS requires both -C and -K" << std::endl;
+        return 1;
+    }
+    if (!certFile.empty() && eventDriven) {
+        std::cerr << "TLS is supported in sequential mode only (without -e)" << std::endl;
+        return 1;
+    }
+    if (batchLanes > 0 && !eventDriven) {
+        std::cerr << "Shared passes require event-driven mode (-e)" << std::endl;
+        return 1;
+    }
+    
+    // Отключившийся клиент не должен завершать сервер сигналом SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
     // Создаем и запускаем сервер
     Server server(port, configFile, logFile);
-    std::cout << "Starting server on port " << port << std::endl;
+    server.setListenSocket(listenFd);
+    server.setEventDriven(eventDriven);
+    server.setSocketTuning(socketTuning);
+    server.setWorkers(static_cast<size_t>(workers), rebalanceInterval);
+    server.setMicroBatch(static_cast<size_t>(batchLanes), batchWindow);
+    server.setWatchdog(stallThreshold);
+    server.setHugePages(hugePages);
+    server.setMetricsPath(metricsFile);
+    
+    std::unique_ptr<ResultJournal> journal;
+    if (!journalFile.empty()) {
+        journal = std::make_unique<ResultJournal>(journalFile, commitInterval, commitBatch);
+        if (!journal->open()) {
+            std::cerr << "Cannot open result journal: " << journalFile << std::endl;
+            return 1;
+        }
+        server.setJournal(journal.get(), journalStrict);
+        std::cout << "Result journal: " << journalFile << (journalStrict ? " (strict)" : "") << std::endl;
+    }
+    std::unique_ptr<ResultTap> tap;
+    if (!tapName.empty()) {
+        tap = std::make_unique<ResultTap>(tapName);
+        if (!tap->open(replaceTap)) {
+            if (errno == EEXIST) {
+                std::cerr << "Shared-memory result ring already exists: " << tapName
+                          << " (another server running? use -O to replace a stale ring)" << std::endl;
+            } else {
+                std::cerr << "Cannot create shared-memory result ring: " << tapName << std::endl;
+            }
+            return 1;
+        }
+        server.setResultTap(tap.get());
+        std::cout << "Result ring: " << tapName << " (" << kTapCapacity << " records)" << std::endl;
+    }
+    std::unique_ptr<TlsContext> tls;
+    if (!certFile.empty()) {
+        tls = std::make_unique<TlsContext>(certFile, keyFile, kernelTls);
+        if (!tls->open()) {
+            std::cerr << "Cannot load TLS certificate or key: " << certFile << ", " << keyFile << std::endl;
+            return 1;
+        }
+        server.setTls(tls.get());
+        std::cout << "TLS enabled" << (kernelTls ? " (kernel offload when available)" : " (user space)") << std::endl;
+    }
+    if (listenFd >= 0) {
+        std::cout << "Starting server on inherited socket " << listenFd << std::endl;
+    } else {
+        std::cout << "Starting server on port " << port << std::endl;
+    }
     std::cout << "User database: " << configFile << std::endl;
     std::cout << "Log file: " << logFile << std::endl;
     
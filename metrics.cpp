@@ -0,0 +1,84 @@
+/**
+ * @file metrics.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация выгрузки счетчиков сервера.
+ */
+
+#include "metrics.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+const uint64_t LatencyHistogram::kBoundsUs[LatencyHistogram::kBuckets] = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 2000000, 5000000, 10000000};
+
+void LatencyHistogram::observe(uint64_t microseconds) {
+    size_t bucket = 0;
+    while (bucket < kBuckets && microseconds > kBoundsUs[bucket]) {
+        ++bucket;
+    }
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(microseconds, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string LatencyHistogram::format(const std::string& name) const {
+    std::ostringstream out;
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= kBuckets; ++i) {
+        cumulative += counts[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{le=\"";
+        if (i < kBuckets) {
+            out << static_cast<double>(kBoundsUs[i]) / 1000.0;
+        } else {
+            out << "+Inf";
+        }
+        out << "\"} " << cumulative << "\n";
+    }
+    out << name << "_sum " << static_cast<double>(sumUs.load(std::memory_order_relaxed)) / 1000.0 << "\n"
+        << name << "_count " << total.load(std::memory_order_relaxed) << "\n";
+    return out.str();
+}
+
+std::string ServerMetrics::format() const {
+    std::ostringstream out;
+    out << "scale_connections_accepted_total " << connectionsAccepted.load() << "\n"
+        << "scale_vectors_processed_total " << vectorsProcessed.load() << "\n"
+        << "scale_batches_cancelled_total{reason=\"deadline\"} " << batchesCancelledDeadline.load() << "\n"
+        << "scale_batches_cancelled_total{reason=\"disconnect\"} " << batchesCancelledDisconnect.load() << "\n"
+        << "scale_vectors_cancelled_total " << vectorsCancelled.load() << "\n"
+        << "scale_tls_sessions_total{offload=\"kernel\"} " << tlsSessionsKernel.load() << "\n"
+        << "scale_tls_sessions_total{offload=\"user\"} " << tlsSessionsUser.load() << "\n"
+        << "scale_sessions_migrated_total " << sessionsMigrated.load() << "\n"
+        << "scale_socket_buffers_tuned_total " << socketsTuned.load() << "\n"
+        << "scale_socket_rcvbuf_sized_total " << receiveBuffersSized.load() << "\n"
+        << "scale_socket_rcvbuf_bytes_sum " << receiveBufferBytes.load() << "\n"
+        << "scale_socket_sndbuf_bytes_sum " << sendBufferBytes.load() << "\n"
+        << "scale_socket_rcvbuf_bytes " << lastReceiveBuffer.load() << "\n"
+        << "scale_socket_sndbuf_bytes " << lastSendBuffer.load() << "\n"
+        << "scale_huge_page_bytes " << hugePageBytes.load() << "\n"
+        << "scale_stalls_total " << stalls.load() << "\n"
+        << "scale_microbatches_total " << microBatches.load() << "\n"
+        << "scale_microbatch_lanes_total " << microBatchLanes.load() << "\n"
+        << "scale_vectors_stored_total " << vectorsStored.load() << "\n"
+        << "scale_ranges_answered_total " << rangesAnswered.load() << "\n"
+        << loopLag.format("scale_loop_lag_ms")
+        << stallDuration.format("scale_stall_duration_ms");
+    return out.str();
+}
+
+bool ServerMetrics::writeTo(const std::string& path) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << format();
+        if (!file.good()) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file metrics.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл счетчиков сервера.
+ * @details Счетчики обновляются из потоков обработки без блокировок и
+ *          периодически выгружаются в текстовый файл в формате Prometheus.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Гистограмма длительностей с фиксированными границами корзин.
+ * @details Наблюдения хранятся в микросекундах, границы выгружаются в
+ *          миллисекундах (метки le, как в гистограммах Prometheus).
+ */
+struct LatencyHistogram {
+    /// Количество корзин с конечной границей.
+    static const size_t kBuckets = 12;
+
+    /// Верхние границы корзин, мкс.
+    static const uint64_t kBoundsUs[kBuckets];
+
+    std::atomic<uint64_t> counts[kBuckets + 1] = {}; ///< Наблюдения по корзинам (последняя — +Inf)
+    std::atomic<uint64_t> sumUs{0};                   ///< Сумма наблюдений, мкс
+    std::atomic<uint64_t> total{0};                   ///< Количество наблюдений
+
+    /**
+     * @brief Учитывает наблюдение.
+     * @param microseconds Длительность, мкс.
+     */
+    void observe(uint64_t microseconds);
+
+    /**
+     * @brief Формирует строки гистограммы (накопительные корзины, сумма, количество).
+     * @param name Имя метрики без суффиксов.
+     */
+    std::string format(const std::string& name) const;
+};
+
+/**
+ * @brief Счетчики работы сервера.
+ */
+struct ServerMetrics {
+    std::atomic<uint64_t> connectionsAccepted{0};        ///< Принято подключений
+    std::atomic<uint64_t> vectorsProcessed{0};           ///< Вычислено векторов
+    std::atomic<uint64_t> batchesCancelledDeadline{0};   ///< Пакеты, отмененные по сроку
+    std::atomic<uint64_t> batchesCancelledDisconnect{0}; ///< Пакеты, отмененные из-за ухода клиента
+    std::atomic<uint64_t> vectorsCancelled{0};           ///< Векторы, которые не пришлось вычислять
+    std::atomic<uint64_t> tlsSessionsKernel{0};          ///< TLS-подключения с шифрованием в ядре
+    std::atomic<uint64_t> tlsSessionsUser{0};            ///< TLS-подключения с шифрованием в OpenSSL
+    std::atomic<uint64_t> sessionsMigrated{0};           ///< Подключения, переданные другому циклу
+    std::atomic<uint64_t> socketsTuned{0};               ///< Подключения с подобранными буферами
+    std::atomic<uint64_t> receiveBuffersSized{0};        ///< Из них с явным SO_RCVBUF (большие пакеты)
+    std::atomic<uint64_t> receiveBufferBytes{0};         ///< Сумма фактических SO_RCVBUF
+    std::atomic<uint64_t> sendBufferBytes{0};            ///< Сумма фактических SO_SNDBUF
+    std::atomic<uint64_t> lastReceiveBuffer{0};          ///< SO_RCVBUF последнего подключения
+    std::atomic<uint64_t> lastSendBuffer{0};             ///< SO_SNDBUF последнего подключения
+    std::atomic<uint64_t> hugePageBytes{0};              ///< Код и данные только для чтения на больших страницах
+    std::atomic<uint64_t> stalls{0};                     ///< Зависания, обнаруженные сторожем
+    std::atomic<uint64_t> microBatches{0};               ///< Общие проходы крошечных векторов
+    std::atomic<uint64_t> microBatchLanes{0};            ///< Векторы, посчитанные в общих проходах
+    std::atomic<uint64_t> vectorsStored{0};              ///< Векторы, сохраненные для запросов по диапазонам
+    std::atomic<uint64_t> rangesAnswered{0};             ///< Отвеченные диапазоны
+    LatencyHistogram loopLag;                            ///< Длительность единиц работы цикла
+    LatencyHistogram stallDuration;                      ///< Длительность зависаний
+
+    /**
+     * @brief Формирует текстовое представление счетчиков.
+     * @return Строки вида "scale_имя значение".
+     */
+    std::string format() const;
+
+    /**
+     * @brief Атомарно перезаписывает файл счетчиков (через временный файл).
+     * @param path Путь к файлу.
+     * @return true если файл записан.
+     */
+    bool writeTo(const std::string& path) const;
+};
+
+#endif // METRICS_H
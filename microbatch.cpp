@@ -0,0 +1,44 @@
+/**
+ * @file microbatch.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация общих проходов суммы квадратов.
+ */
+
+#include "microbatch.h"
+#include <algorithm>
+#include <cstring>
+
+void sumLaneSquares(const int16_t* lanes, size_t laneCount, int16_t* results) {
+    // Ширина дорожки постоянна: внутренний цикл без ветвлений разворачивается в SIMD
+    for (size_t lane = 0; lane < laneCount; ++lane) {
+        const int16_t* values = lanes + lane * kLaneElements;
+        int64_t sum = 0;
+        for (size_t i = 0; i < kLaneElements; ++i) {
+            sum += static_cast<int32_t>(values[i]) * values[i];
+        }
+        results[lane] = sum > 32767 ? 32767 : static_cast<int16_t>(sum);
+    }
+}
+
+MicroBatch::MicroBatch(size_t lanes, int windowUs)
+    : capacity(std::min(lanes, kMaxBatchLanes)), window(std::chrono::microseconds(windowUs)),
+      lanes(capacity * kLaneElements), owners(capacity), lengths(capacity), results(capacity) {}
+
+bool MicroBatch::add(Session* owner, const uint8_t* data, uint32_t elements) {
+    if (used == 0) {
+        opened = std::chrono::steady_clock::now();
+    }
+    int16_t* lane = lanes.data() + used * kLaneElements;
+    std::memcpy(lane, data, elements * sizeof(int16_t));
+    std::fill(lane + elements, lane + kLaneElements, 0);
+    owners[used] = owner;
+    lengths[used] = elements;
+    ++used;
+    return used == capacity;
+}
+
+int64_t MicroBatch::remainingNs(std::chrono::steady_clock::time_point now) const {
+    int64_t left = std::chrono::duration_cast<std::chrono::nanoseconds>(opened + window - now).count();
+    return left > 0 ? left : 0;
+}
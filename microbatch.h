@@ -0,0 +1,104 @@
+/**
+ * @file microbatch.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Общие проходы суммы квадратов для крошечных векторов разных подключений.
+ * @details Когда тысячи клиентов присылают по одному-два коротких вектора,
+ *          ни одно подключение не дает достаточно работы для пакетного
+ *          вычисления, и накладные расходы на вектор превышают саму
+ *          арифметику. Событийный цикл складывает такие векторы в дорожки
+ *          фиксированной ширины (дополняя нулями) и в течение короткого окна
+ *          или до заполнения всех дорожек копит их из разных подключений;
+ *          затем один проход считает суммы всех дорожек, а результаты
+ *          раздаются владельцам в порядке поступления.
+ */
+
+#ifndef MICROBATCH_H
+#define MICROBATCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Session;
+
+/// Элементов в одной дорожке: векторы длиннее считаются потоково, как раньше.
+static const size_t kLaneElements = 8;
+
+/// Наибольшее количество дорожек в одном проходе.
+static const size_t kMaxBatchLanes = 4096;
+
+/// Окно накопления по умолчанию, мкс.
+static const int kDefaultBatchWindowUs = 20;
+
+/**
+ * @brief Считает насыщенные суммы квадратов для подряд лежащих дорожек.
+ * @param lanes Элементы дорожек (laneCount * kLaneElements, хвосты дополнены нулями).
+ * @param laneCount Количество дорожек.
+ * @param results Результаты (laneCount значений, не больше 32767).
+ */
+void sumLaneSquares(const int16_t* lanes, size_t laneCount, int16_t* results);
+
+/**
+ * @brief Накопитель крошечных векторов одного событийного цикла.
+ */
+class MicroBatch {
+public:
+    /**
+     * @brief Конструктор.
+     * @param lanes Количество дорожек (0 — накопление отключено; не больше kMaxBatchLanes).
+     * @param windowUs Сколько самая старая дорожка может ждать прохода, мкс.
+     */
+    MicroBatch(size_t lanes, int windowUs);
+
+    /**
+     * @brief Проверяет, помещается ли вектор такой длины в дорожку.
+     */
+    bool fits(uint32_t elements) const { return capacity > 0 && elements > 0 && elements <= kLaneElements; }
+
+    /**
+     * @brief Копирует вектор в следующую свободную дорожку.
+     * @param owner Сессия, которой принадлежит вектор.
+     * @param data Элементы в little-endian (без требований к выравниванию).
+     * @param elements Количество элементов (fits() == true).
+     * @return true если после добавления все дорожки заняты.
+     */
+    bool add(Session* owner, const uint8_t* data, uint32_t elements);
+
+    /**
+     * @brief Вычисляет результаты всех занятых дорожек одним проходом.
+     */
+    void compute() { sumLaneSquares(lanes.data(), used, results.data()); }
+
+    /**
+     * @brief Освобождает все дорожки.
+     */
+    void clear() { used = 0; }
+
+    bool empty() const { return used == 0; }
+    size_t size() const { return used; }
+
+    Session* owner(size_t lane) const { return owners[lane]; }
+    uint32_t length(size_t lane) const { return lengths[lane]; }
+    int16_t result(size_t lane) const { return results[lane]; }
+
+    /**
+     * @brief Возвращает, сколько еще можно ждать новых векторов.
+     * @param now Текущее время.
+     * @return Остаток окна, нс (0 — пора считать).
+     */
+    int64_t remainingNs(std::chrono::steady_clock::time_point now) const;
+
+private:
+    size_t capacity;                          ///< Количество дорожек
+    std::chrono::nanoseconds window;          ///< Окно накопления
+    std::chrono::steady_clock::time_point opened; ///< Время занятия первой дорожки
+    size_t used = 0;                          ///< Занято дорожек
+    std::vector<int16_t> lanes;               ///< Элементы дорожек
+    std::vector<Session*> owners;             ///< Владельцы дорожек
+    std::vector<uint32_t> lengths;            ///< Длины векторов
+    std::vector<int16_t> results;             ///< Результаты последнего прохода
+};
+
+#endif // MICROBATCH_H
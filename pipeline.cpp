@@ -0,0 +1,157 @@
+/**
+ * @file pipeline.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация совмещения приема, вычисления и отправки.
+ */
+
+#include "pipeline.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <sys/socket.h>
+
+int64_t accumulateSquares(const uint8_t* data, size_t count) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int16_t value;
+        std::memcpy(&value, data + i * sizeof(int16_t), sizeof(value));
+        sum += static_cast<int32_t>(value) * value;
+    }
+    return sum;
+}
+
+size_t SquareSum::add(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    int64_t total = sum;
+    size_t completed = 0;
+    // Элемент, разорванный между двумя участками приема
+    if (hasOddByte) {
+        int16_t value = static_cast<int16_t>(oddByte | (data[0] << 8));
+        total += static_cast<int32_t>(value) * value;
+        hasOddByte = false;
+        completed = 1;
+        ++data;
+        --size;
+    }
+    size_t count = size / sizeof(int16_t);
+    // После насыщения значение уже известно: элементы только пропускаем
+    if (total <= 32767) {
+        total += accumulateSquares(data, count);
+    }
+    if (size % sizeof(int16_t) != 0) {
+        oddByte = data[size - 1];
+        hasOddByte = true;
+    }
+    sum = total > 32767 ? 32768 : static_cast<int32_t>(total);
+    return completed + count;
+}
+
+ReceivePipeline::ReceivePipeline(size_t bufferSize)
+    : bufferSize(bufferSize), front(new uint8_t[bufferSize]), back(new uint8_t[bufferSize]) {}
+
+void ReceivePipeline::reset(Receive receiveFunction, bool overlapReceive) {
+    receive = std::move(receiveFunction);
+    overlap = overlapReceive;
+    frontPos = 0;
+    frontEnd = 0;
+    backEnd = 0;
+    closed = false;
+}
+
+bool ReceivePipeline::fill() {
+    if (frontPos < frontEnd) {
+        return true;
+    }
+    if (backEnd > 0) {
+        std::swap(front, back);
+        frontPos = 0;
+        frontEnd = backEnd;
+        backEnd = 0;
+        return true;
+    }
+    if (closed) {
+        return false;
+    }
+    ssize_t bytesRead = receive(front.get(), bufferSize, 0);
+    if (bytesRead <= 0) {
+        closed = true;
+        return false;
+    }
+    frontPos = 0;
+    frontEnd = static_cast<size_t>(bytesRead);
+    return true;
+}
+
+bool ReceivePipeline::read(void* out, size_t size) {
+    uint8_t* target = static_cast<uint8_t*>(out);
+    while (size > 0) {
+        const uint8_t* data;
+        size_t taken = next(data, size);
+        if (taken == 0) {
+            return false;
+        }
+        std::memcpy(target, data, taken);
+        target += taken;
+        size -= taken;
+    }
+    return true;
+}
+
+size_t ReceivePipeline::next(const uint8_t*& data, size_t limit) {
+    if (limit == 0 || !fill()) {
+        return 0;
+    }
+    size_t taken = std::min(limit, frontEnd - frontPos);
+    data = front.get() + frontPos;
+    frontPos += taken;
+    return taken;
+}
+
+void ReceivePipeline::drain() {
+    while (overlap && !closed && backEnd < bufferSize) {
+        ssize_t bytesRead = receive(back.get() + backEnd, bufferSize - backEnd, MSG_DONTWAIT);
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return;
+        }
+        if (bytesRead <= 0) {
+            // Ошибку увидит следующий блокирующий прием, когда буферы опустеют
+            closed = true;
+            return;
+        }
+        backEnd += static_cast<size_t>(bytesRead);
+    }
+}
+
+SendQueue::SendQueue(Send sendFunction, bool nonBlocking) : send(std::move(sendFunction)), nonBlocking(nonBlocking) {}
+
+void SendQueue::push(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+bool SendQueue::flush(bool wait) {
+    int flags = (nonBlocking && !wait) ? MSG_DONTWAIT : 0;
+    while (head < buffer.size()) {
+        ssize_t sent = send(buffer.data() + head, buffer.size() - head, flags);
+        if (sent < 0 && flags != 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        head += static_cast<size_t>(sent);
+    }
+    // Отправленное начало очереди удаляется, когда его набралось достаточно
+    if (head == buffer.size()) {
+        buffer.clear();
+        head = 0;
+    } else if (head >= kMaxPendingOutput) {
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(head));
+        head = 0;
+    }
+    return true;
+}
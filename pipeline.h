@@ -0,0 +1,172 @@
+/**
+ * @file pipeline.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Совмещение приема, вычисления и отправки в последовательном режиме.
+ * @details Раньше подключение строго чередовало этапы: принять вектор
+ *          целиком, посчитать, отправить результат, и только потом читать
+ *          следующий. Теперь данные принимаются в два буфера: из одного
+ *          элементы суммируются фрагментами, а между фрагментами
+ *          неблокирующий recv() забирает в другой буфер все, что уже пришло
+ *          в сокет. Окно TCP не закрывается, пока сервер считает, а
+ *          результаты уходят неблокирующим send(); то, что сокет не принял,
+ *          ждет в очереди отправки.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+/// Размер каждого из двух буферов приема.
+static const size_t kPipelineBuffer = 256 * 1024;
+
+/// Байт вектора, суммируемых между двумя неблокирующими приемами.
+static const size_t kComputeChunk = 32 * 1024;
+
+/// Объем неотправленных результатов, после которого отправка ждет сокет.
+static const size_t kMaxPendingOutput = 64 * 1024;
+
+/**
+ * @brief Суммирует квадраты элементов int16_t, лежащих в буфере подряд.
+ * @param data Байты элементов в little-endian (без требований к выравниванию).
+ * @param count Количество элементов.
+ * @return Сумма квадратов.
+ */
+int64_t accumulateSquares(const uint8_t* data, size_t count);
+
+/**
+ * @brief Сумма квадратов вектора, который приходит участками произвольной длины.
+ * @details Общая для последовательного и событийного режимов: помнит младший
+ *          байт элемента, разорванного между участками, после насыщения
+ *          только пропускает элементы и хранит сумму не больше 32768, поэтому
+ *          умещается в 8 байт состояния сессии.
+ */
+struct SquareSum {
+    int32_t sum = 0;         ///< Сумма квадратов (32768 — насыщение)
+    uint8_t oddByte = 0;     ///< Младший байт неполного элемента
+    bool hasOddByte = false; ///< Есть неполный элемент
+
+    /**
+     * @brief Добавляет следующий участок байт вектора.
+     * @param data Байты элементов в little-endian.
+     * @param size Количество байт (может быть нечетным).
+     * @return Количество элементов, завершенных участком.
+     */
+    size_t add(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Возвращает результат с насыщением до 32767.
+     */
+    int16_t result() const { return sum > 32767 ? 32767 : static_cast<int16_t>(sum); }
+};
+
+/**
+ * @brief Двойной буфер приема одного подключения.
+ */
+class ReceivePipeline {
+public:
+    /// Прием из сокета клиента: (буфер, размер, флаги recv()).
+    using Receive = std::function<ssize_t(void*, size_t, int)>;
+
+    /**
+     * @brief Конструктор.
+     * @param bufferSize Размер каждого буфера.
+     */
+    explicit ReceivePipeline(size_t bufferSize = kPipelineBuffer);
+
+    /**
+     * @brief Начинает прием для нового подключения.
+     * @param receive Функция приема.
+     * @param overlap true — принимать с опережением (MSG_DONTWAIT работает);
+     *                false — только блокирующий прием (TLS в OpenSSL).
+     */
+    void reset(Receive receive, bool overlap);
+
+    /**
+     * @brief Читает ровно size байт (заголовки протокола).
+     * @return false если клиент отключился.
+     */
+    bool read(void* out, size_t size);
+
+    /**
+     * @brief Выдает следующие принятые байты, при необходимости дожидаясь их.
+     * @param data Начало непрерывного участка.
+     * @param limit Сколько байт нужно не больше.
+     * @return Количество байт (0 — клиент отключился).
+     */
+    size_t next(const uint8_t*& data, size_t limit);
+
+    /**
+     * @brief Забирает без ожидания все, что уже пришло, во второй буфер.
+     */
+    void drain();
+
+    /**
+     * @brief Возвращает количество принятых, но еще не выданных байт.
+     */
+    size_t buffered() const { return (frontEnd - frontPos) + backEnd; }
+
+private:
+    size_t bufferSize;                 ///< Размер буфера
+    std::unique_ptr<uint8_t[]> front;  ///< Буфер, из которого выдаются байты
+    std::unique_ptr<uint8_t[]> back;   ///< Буфер, который заполняется с опережением
+    size_t frontPos = 0;               ///< Первый невыданный байт front
+    size_t frontEnd = 0;               ///< Конец данных front
+    size_t backEnd = 0;                ///< Конец данных back
+    bool overlap = false;              ///< Прием с опережением разрешен
+    bool closed = false;               ///< Клиент закрыл соединение или произошла ошибка
+    Receive receive;                   ///< Функция приема
+
+    /**
+     * @brief Делает front непустым: меняет буферы местами или ждет данных.
+     * @return false если клиент отключился.
+     */
+    bool fill();
+};
+
+/**
+ * @brief Очередь результатов, которые сокет еще не принял.
+ */
+class SendQueue {
+public:
+    /// Отправка клиенту: (данные, размер, флаги send()).
+    using Send = std::function<ssize_t(const void*, size_t, int)>;
+
+    /**
+     * @brief Конструктор.
+     * @param send Функция отправки.
+     * @param nonBlocking true — flush(false) не ждет сокет (MSG_DONTWAIT).
+     */
+    SendQueue(Send send, bool nonBlocking);
+
+    /**
+     * @brief Добавляет данные в очередь.
+     */
+    void push(const void* data, size_t size);
+
+    /**
+     * @brief Отправляет очередь.
+     * @param wait true — до конца очереди, false — сколько примет сокет.
+     * @return false при ошибке отправки.
+     */
+    bool flush(bool wait);
+
+    /**
+     * @brief Возвращает количество неотправленных байт.
+     */
+    size_t pending() const { return buffer.size() - head; }
+
+private:
+    Send send;                   ///< Функция отправки
+    bool nonBlocking;            ///< Неблокирующая отправка разрешена
+    std::vector<uint8_t> buffer; ///< Неотправленные данные
+    size_t head = 0;             ///< Начало неотправленных данных
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,402 @@
+/**
+ * @file proxy.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация L4-прокси scale-proxy.
+ * @details Маршрутизация по консистентному хэшированию логина, проверка
+ *          здоровья серверов и пересылка потока через splice() без копирования
+ *          данных в пространство пользователя.
+ */
+
+#include "proxy.h"
+#include "hmacauth.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/// Максимальный объем одного вызова splice().
+static const size_t kSpliceChunk = 64 * 1024;
+
+/// Таймаут подключения к серверу при маршрутизации и проверке здоровья.
+static const int kConnectTimeoutMs = 500;
+
+void HashRing::addBackend(size_t backend, const std::string& key, int virtualNodes) {
+    for (int i = 0; i < virtualNodes; ++i) {
+        ring.emplace_back(hash(key + "#" + std::to_string(i)), backend);
+    }
+    std::sort(ring.begin(), ring.end());
+}
+
+long HashRing::lookup(const std::string& login, const std::function<bool(size_t)>& usable) const {
+    if (ring.empty()) {
+        return -1;
+    }
+
+    uint64_t point = hash(login);
+    auto start = std::lower_bound(ring.begin(), ring.end(), std::make_pair(point, size_t(0)));
+    size_t first = static_cast<size_t>(start - ring.begin());
+
+    // Обходим кольцо по часовой стрелке, пропуская недоступные серверы
+    for (size_t i = 0; i < ring.size(); ++i) {
+        size_t backend = ring[(first + i) % ring.size()].second;
+        if (usable(backend)) {
+            return static_cast<long>(backend);
+        }
+    }
+    return -1;
+}
+
+uint64_t HashRing::hash(const std::string& data) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    // Финальное перемешивание (splitmix64), чтобы близкие ключи расходились по кольцу
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/**
+ * @brief Конструктор прокси.
+ * @param port Порт для прослушивания подключений.
+ * @param addresses Адреса серверов.
+ * @param logPath Путь к файлу журнала.
+ */
+ScaleProxy::ScaleProxy(int port, const std::vector<std::pair<std::string, uint16_t>>& addresses,
+                       const std::string& logPath)
+    : port(port), logPath(logPath) {
+    for (const auto& address : addresses) {
+        auto target = std::make_unique<Backend>();
+        target->host = address.first;
+        target->port = address.second;
+        ring.addBackend(backends.size(), address.first + ":" + std::to_string(address.second));
+        backends.push_back(std::move(target));
+    }
+}
+
+/**
+ * @brief Записывает сообщение в файл журнала прокси.
+ * @param message Текст сообщения.
+ * @param isCritical Флаг критичности.
+ */
+void ScaleProxy::logError(const std::string& message, bool isCritical) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::ofstream logFile(logPath, std::ios::app);
+    if (!logFile.is_open()) {
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+    std::tm timeinfo;
+    localtime_r(&now, &timeinfo);
+
+    logFile << std::put_time(&timeinfo, "%Y-%m-%d %H:%M:%S") << " | "
+            << (isCritical ? "CRITICAL" : "NON-CRITICAL") << " | "
+            << message << std::endl;
+}
+
+long ScaleProxy::selectBackend(const std::string& login) const {
+    uint64_t active = 0;
+    uint64_t healthyCount = 0;
+    for (const auto& target : backends) {
+        if (target->healthy.load(std::memory_order_relaxed)) {
+            active += target->activeConnections.load(std::memory_order_relaxed);
+            ++healthyCount;
+        }
+    }
+    if (healthyCount == 0) {
+        return -1;
+    }
+
+    // Ограничение нагрузки: не более 1.25 от среднего (с учетом нового клиента)
+    uint64_t capacity = (active + 1) * 5 / (4 * healthyCount) + 1;
+    long choice = ring.lookup(login, [this, capacity](size_t index) {
+        const Backend& target = *backends[index];
+        return target.healthy.load(std::memory_order_relaxed) &&
+               target.activeConnections.load(std::memory_order_relaxed) < capacity;
+    });
+    if (choice >= 0) {
+        return choice;
+    }
+
+    return ring.lookup(login, [this](size_t index) {
+        return backends[index]->healthy.load(std::memory_order_relaxed);
+    });
+}
+
+int ScaleProxy::connectBackend(const Backend& target, int timeoutMs) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(target.port);
+    if (inet_pton(AF_INET, target.host.c_str(), &addr.sin_addr) != 1) {
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (errno != EINPROGRESS) {
+            close(fd);
+            return -1;
+        }
+        pollfd pfd{fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (poll(&pfd, 1, timeoutMs) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    // Дальше сокет используется в блокирующем режиме
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/**
+ * @brief Возвращает монотонное время в миллисекундах.
+ */
+static int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ScaleProxy::probeDue(const Backend& target, int64_t nowMs) const {
+    int64_t last = target.lastConnectedMs.load(std::memory_order_relaxed);
+    return !target.healthy.load(std::memory_order_relaxed) || last == 0 || nowMs - last >= healthIntervalMs;
+}
+
+void ScaleProxy::healthLoop() {
+    while (true) {
+        for (auto& target : backends) {
+            if (!probeDue(*target, steadyMs())) {
+                continue;
+            }
+            int fd = connectBackend(*target, kConnectTimeoutMs);
+            bool healthy = fd >= 0;
+            if (fd >= 0) {
+                close(fd);
+            }
+
+            if (target->healthy.exchange(healthy) != healthy) {
+                logError("Backend " + target->host + ":" + std::to_string(target->port) +
+                         (healthy ? " is up" : " is down") +
+                         ", active " + std::to_string(target->activeConnections.load()) +
+                         ", total " + std::to_string(target->totalConnections.load()),
+                         !healthy);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(healthIntervalMs));
+    }
+}
+
+void ScaleProxy::splicePair(int clientSocket, int backendSocket) {
+    struct Direction {
+        int from;
+        int to;
+        int pipe[2];
+        bool closed;
+    } directions[2] = {
+        {clientSocket, backendSocket, {-1, -1}, false},
+        {backendSocket, clientSocket, {-1, -1}, false},
+    };
+
+    bool useSplice = pipe2(directions[0].pipe, O_CLOEXEC) == 0 &&
+                     pipe2(directions[1].pipe, O_CLOEXEC) == 0;
+    char buffer[kSpliceChunk / 4];
+
+    bool failed = false;
+    while (!failed && !(directions[0].closed && directions[1].closed)) {
+        pollfd fds[2];
+        nfds_t count = 0;
+        Direction* order[2];
+        for (auto& direction : directions) {
+            if (!direction.closed) {
+                fds[count] = {direction.from, POLLIN, 0};
+                order[count++] = &direction;
+            }
+        }
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (nfds_t i = 0; i < count && !failed; ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            Direction& direction = *order[i];
+
+            ssize_t received;
+            if (useSplice) {
+                received = splice(direction.from, nullptr, direction.pipe[1], nullptr,
+                                  kSpliceChunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            } else {
+                received = recv(direction.from, buffer, sizeof(buffer), MSG_DONTWAIT);
+            }
+
+            if (received == 0) {
+                // Полузакрытие: передаем FIN дальше и ждем второе направление
+                shutdown(direction.to, SHUT_WR);
+                direction.closed = true;
+                continue;
+            }
+            if (received < 0) {
+                failed = errno != EAGAIN && errno != EINTR;
+                continue;
+            }
+
+            // Выгружаем pipe в получателя целиком (сокет получателя блокирующий)
+            size_t offset = 0;
+            while (offset < static_cast<size_t>(received)) {
+                ssize_t sent;
+                if (useSplice) {
+                    sent = splice(direction.pipe[0], nullptr, direction.to, nullptr,
+                                  static_cast<size_t>(received) - offset, SPLICE_F_MOVE);
+                } else {
+                    sent = send(direction.to, buffer + offset, static_cast<size_t>(received) - offset,
+                                MSG_NOSIGNAL);
+                }
+                if (sent <= 0) {
+                    failed = true;
+                    break;
+                }
+                offset += static_cast<size_t>(sent);
+            }
+        }
+    }
+
+    for (auto& direction : directions) {
+        if (direction.pipe[0] >= 0) {
+            close(direction.pipe[0]);
+            close(direction.pipe[1]);
+        }
+    }
+}
+
+void ScaleProxy::relayClient(int clientSocket) {
+    // Читаем только логин: дальше поток пересылается без разбора
+    char buffer[256];
+    ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+    if (bytesRead <= 0) {
+        logError("No login received from client", false);
+        close(clientSocket);
+        return;
+    }
+    std::string login(buffer, static_cast<size_t>(bytesRead));
+    // Режим аутентификации не влияет на выбор сервера
+    takeHmacPrefix(login);
+
+    int backendSocket = -1;
+    Backend* target = nullptr;
+    for (size_t attempt = 0; attempt < backends.size() && backendSocket < 0; ++attempt) {
+        long index = selectBackend(login);
+        if (index < 0) {
+            break;
+        }
+        target = backends[static_cast<size_t>(index)].get();
+        backendSocket = connectBackend(*target, kConnectTimeoutMs);
+        if (backendSocket < 0) {
+            target->healthy = false;
+            logError("Backend " + target->host + ":" + std::to_string(target->port) +
+                     " refused connection, marked down", true);
+        }
+    }
+
+    if (backendSocket < 0) {
+        send(clientSocket, "ERR", 3, MSG_NOSIGNAL);
+        logError("No healthy backend for login: " + login, true);
+        close(clientSocket);
+        return;
+    }
+
+    target->activeConnections++;
+    target->totalConnections++;
+    target->lastConnectedMs.store(steadyMs(), std::memory_order_relaxed);
+
+    if (send(backendSocket, buffer, static_cast<size_t>(bytesRead), MSG_NOSIGNAL) == bytesRead) {
+        splicePair(clientSocket, backendSocket);
+    } else {
+        logError("Failed to forward login to backend", false);
+    }
+
+    target->activeConnections--;
+    close(backendSocket);
+    close(clientSocket);
+}
+
+/**
+ * @brief Запускает прокси.
+ * @return false при ошибке создания слушающего сокета.
+ */
+bool ScaleProxy::start() {
+    if (backends.empty()) {
+        std::cerr << "ERROR: No backends configured" << std::endl;
+        return false;
+    }
+
+    int proxySocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (proxySocket < 0) {
+        logError("Cannot create socket", true);
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(proxySocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in proxyAddr{};
+    proxyAddr.sin_family = AF_INET;
+    proxyAddr.sin_addr.s_addr = INADDR_ANY;
+    proxyAddr.sin_port = htons(port);
+    if (bind(proxySocket, reinterpret_cast<sockaddr*>(&proxyAddr), sizeof(proxyAddr)) < 0 ||
+        listen(proxySocket, SOMAXCONN) < 0) {
+        logError("Cannot bind proxy to port " + std::to_string(port), true);
+        close(proxySocket);
+        return false;
+    }
+
+    logError("Proxy started on port " + std::to_string(port) + " with " +
+             std::to_string(backends.size()) + " backends", false);
+
+    std::thread(&ScaleProxy::healthLoop, this).detach();
+
+    while (true) {
+        int clientSocket = accept(proxySocket, nullptr, nullptr);
+        if (clientSocket < 0) {
+            logError("Cannot accept client connection", false);
+            continue;
+        }
+        int one = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(&ScaleProxy::relayClient, this, clientSocket).detach();
+    }
+
+    close(proxySocket);
+    return true;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file proxy.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл L4-прокси scale-proxy.
+ * @details Прокси принимает подключения клиентов, читает только логин,
+ *          выбирает экземпляр Server по консистентному хэшированию логина
+ *          и дальше пересылает поток байт без разбора (splice через pipe).
+ */
+
+#ifndef PROXY_H
+#define PROXY_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Кольцо консистентного хэширования.
+ * @details Каждый сервер представлен несколькими виртуальными узлами, поэтому
+ *          добавление или удаление сервера переносит лишь ~1/N логинов.
+ */
+class HashRing {
+public:
+    /**
+     * @brief Добавляет сервер в кольцо.
+     * @param backend Индекс сервера, который вернет lookup().
+     * @param key Стабильный ключ сервера (например, "127.0.0.1:33333").
+     * @param virtualNodes Количество виртуальных узлов.
+     */
+    void addBackend(size_t backend, const std::string& key, int virtualNodes = 128);
+
+    /**
+     * @brief Находит сервер для логина.
+     * @param login Логин клиента.
+     * @param usable Предикат доступности сервера (здоров и не перегружен).
+     * @return Индекс первого подходящего сервера по часовой стрелке или -1.
+     */
+    long lookup(const std::string& login, const std::function<bool(size_t)>& usable) const;
+
+    /**
+     * @brief Возвращает количество виртуальных узлов в кольце.
+     */
+    size_t size() const { return ring.size(); }
+
+    /**
+     * @brief 64-битный хэш FNV-1a с финальным перемешиванием.
+     * @param data Входная строка.
+     * @return Значение хэша.
+     */
+    static uint64_t hash(const std::string& data);
+
+private:
+    std::vector<std::pair<uint64_t, size_t>> ring; ///< Отсортированные (хэш, сервер)
+};
+
+/**
+ * @brief Экземпляр Server за прокси.
+ */
+struct Backend {
+    std::string host;                            ///< IPv4-адрес сервера
+    uint16_t port = 0;                           ///< Порт сервера
+    std::atomic<bool> healthy{true};             ///< Результат последней проверки
+    std::atomic<uint32_t> activeConnections{0};  ///< Текущие клиенты на сервере
+    std::atomic<uint64_t> totalConnections{0};   ///< Всего направлено клиентов
+    std::atomic<int64_t> lastConnectedMs{0};     ///< Последнее удачное подключение клиента, мс steady_clock
+};
+
+/**
+ * @brief L4-прокси, распределяющий клиентов между серверами.
+ */
+class ScaleProxy {
+public:
+    /**
+     * @brief Конструктор прокси.
+     * @param port Порт для прослушивания подключений.
+     * @param backends Адреса серверов в виде пар (хост, порт).
+     * @param logPath Путь к файлу журнала прокси.
+     */
+    ScaleProxy(int port, const std::vector<std::pair<std::string, uint16_t>>& backends,
+               const std::string& logPath);
+
+    /**
+     * @brief Задает период проверки здоровья серверов.
+     * @param milliseconds Интервал между проверками.
+     * @details Проверка — пустое TCP-подключение, которое занимает цикл приема
+     *          сервера и оставляет в его логе пару строк. Поэтому сервер, к
+     *          которому за последний интервал удачно подключился клиент,
+     *          не проверяется: живость уже подтверждена трафиком.
+     */
+    void setHealthInterval(int milliseconds) { healthIntervalMs = milliseconds; }
+
+    /**
+     * @brief Запускает прокси: проверку здоровья и цикл приема подключений.
+     * @return false при ошибке запуска.
+     */
+    bool start();
+
+    /**
+     * @brief Выбирает сервер для логина с учетом здоровья и нагрузки.
+     * @param login Логин клиента.
+     * @return Индекс сервера или -1, если доступных нет.
+     * @details Консистентное хэширование с ограничением нагрузки: сервер
+     *          пропускается, если у него больше чем в 1.25 раза клиентов
+     *          от среднего по здоровым серверам (плюс один).
+     */
+    long selectBackend(const std::string& login) const;
+
+    /**
+     * @brief Возвращает сервер по индексу.
+     */
+    Backend& backend(size_t index) { return *backends[index]; }
+
+    /**
+     * @brief Проверяет, нужна ли серверу пробная проверка.
+     * @param target Сервер.
+     * @param nowMs Текущее время, мс steady_clock.
+     * @return false если сервер здоров и клиенты подключались к нему за последний интервал.
+     */
+    bool probeDue(const Backend& target, int64_t nowMs) const;
+
+private:
+    int port;                                        ///< Порт прокси
+    std::string logPath;                             ///< Путь к файлу журнала
+    std::mutex logMutex;                             ///< Порядок строк лога из потоков клиентов
+    int healthIntervalMs = 2000;                     ///< Период проверки здоровья
+    std::vector<std::unique_ptr<Backend>> backends;  ///< Серверы за прокси
+    HashRing ring;                                   ///< Кольцо консистентного хэширования
+
+    /**
+     * @brief Записывает сообщение в журнал прокси.
+     */
+    void logError(const std::string& message, bool isCritical);
+
+    /**
+     * @brief Подключается к серверу с таймаутом.
+     * @return Дескриптор сокета или -1.
+     */
+    int connectBackend(const Backend& target, int timeoutMs);
+
+    /**
+     * @brief Периодически проверяет доступность серверов.
+     */
+    void healthLoop();
+
+    /**
+     * @brief Обслуживает одного клиента: маршрутизация и пересылка потока.
+     * @param clientSocket Дескриптор сокета клиента.
+     */
+    void relayClient(int clientSocket);
+
+    /**
+     * @brief Пересылает байты в обе стороны до закрытия обоих направлений.
+     * @param clientSocket Сокет клиента.
+     * @param backendSocket Сокет сервера.
+     */
+    void splicePair(int clientSocket, int backendSocket);
+};
+
+#endif // PROXY_H
@@ -0,0 +1,121 @@
+/**
+ * @file proxy_main.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Точка входа L4-прокси scale-proxy.
+ * @details Парсит аргументы командной строки, создает и запускает прокси,
+ *          распределяющий клиентов между несколькими экземплярами сервера.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <csignal>
+#include "proxy.h"
+
+/**
+ * @brief Выводит справочную информацию о параметрах командной строки.
+ */
+void showHelp() {
+    std::cout << "Usage: scale-proxy [OPTIONS]\n"
+              << "Options:\n"
+              << "  -h              Show this help\n"
+              << "  -p PORT         Port number (default: 33333)\n"
+              << "  -b HOST:PORT    Backend server (repeat for each backend)\n"
+              << "  -i MILLISECONDS Backend health check interval (default: 2000); a backend that\n"
+              << "                  accepted a client within the interval is not probed\n"
+              << "  -l LOG_FILE     Log file (default: /log/scale-proxy.log)\n";
+}
+
+/**
+ * @brief Разбирает адрес сервера вида HOST:PORT.
+ * @param text Строка адреса.
+ * @param address Результат разбора.
+ * @return true если адрес корректен.
+ */
+static bool parseBackend(const std::string& text, std::pair<std::string, uint16_t>& address) {
+    size_t pos = text.rfind(':');
+    if (pos == std::string::npos || pos == 0) {
+        return false;
+    }
+    try {
+        int port = std::stoi(text.substr(pos + 1));
+        if (port < 1 || port > 65535) {
+            return false;
+        }
+        address = {text.substr(0, pos), static_cast<uint16_t>(port)};
+        return true;
+    } catch (const std::exception& e) {
+        return false;
+    }
+}
+
+/**
+ * @brief Основная функция прокси.
+ * @return 0 при показе справки, 1 при ошибке запуска.
+ */
+int main(int argc, char* argv[]) {
+    int port = 33333;
+    int healthInterval = 2000;
+    std::string logFile = "/log/scale-proxy.log";
+    std::vector<std::pair<std::string, uint16_t>> backends;
+
+    if (argc == 1) {
+        showHelp();
+        return 0;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-h") == 0) {
+            showHelp();
+            return 0;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            try {
+                port = std::stoi(argv[++i]);
+                if (port < 1 || port > 65535) {
+                    std::cerr << "Invalid port number: " << port << std::endl;
+                    return 1;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid port number: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            std::pair<std::string, uint16_t> address;
+            if (!parseBackend(argv[++i], address)) {
+                std::cerr << "Invalid backend address: " << argv[i] << std::endl;
+                return 1;
+            }
+            backends.push_back(address);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            try {
+                healthInterval = std::stoi(argv[++i]);
+                if (healthInterval < 1) {
+                    std::cerr << "Invalid interval: " << healthInterval << std::endl;
+                    return 1;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Invalid interval: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            logFile = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            showHelp();
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    ScaleProxy proxy(port, backends, logFile);
+    proxy.setHealthInterval(healthInterval);
+    std::cout << "Starting scale-proxy on port " << port << " with "
+              << backends.size() << " backends" << std::endl;
+
+    if (!proxy.start()) {
+        std::cerr << "Failed to start proxy" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file rangeindex.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация хранимых векторов и индекса префиксных сумм.
+ */
+
+#include "rangeindex.h"
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Сумма квадратов произвольного числа элементов (концы диапазонов).
+ */
+static uint64_t sumOfSquaresScalar(const int16_t* values, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += static_cast<uint64_t>(static_cast<int32_t>(values[i]) * values[i]);
+    }
+    return sum;
+}
+
+uint64_t blockSumOfSquares(const int16_t* values) {
+#ifdef __SSE2__
+    // pmaddwd складывает квадраты соседних пар: не больше 2^31, поэтому без знака;
+    // перед сложением восьми пар значения расширяются до 64 бит
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + 8));
+    __m128i pairsLow = _mm_madd_epi16(low, low);
+    __m128i pairsHigh = _mm_madd_epi16(high, high);
+    __m128i sum = _mm_add_epi64(_mm_add_epi64(_mm_unpacklo_epi32(pairsLow, zero), _mm_unpackhi_epi32(pairsLow, zero)),
+                                _mm_add_epi64(_mm_unpacklo_epi32(pairsHigh, zero), _mm_unpackhi_epi32(pairsHigh, zero)));
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+    return lanes[0] + lanes[1];
+#else
+    return sumOfSquaresScalar(values, kIndexBlock);
+#endif
+}
+
+PrefixIndex::PrefixIndex(std::vector<int16_t> values) : values(std::move(values)) {
+    size_t blocks = this->values.size() / kIndexBlock;
+    prefix.resize(blocks + 1);
+    prefix[0] = 0;
+    const int16_t* data = this->values.data();
+    for (size_t block = 0; block < blocks; ++block) {
+        prefix[block + 1] = prefix[block] + blockSumOfSquares(data + block * kIndexBlock);
+    }
+}
+
+uint64_t PrefixIndex::sumOfSquares(size_t start, size_t end) const {
+    size_t startBlock = start / kIndexBlock;
+    size_t endBlock = end / kIndexBlock;
+    const int16_t* data = values.data();
+    return prefix[endBlock] - prefix[startBlock] +
+           sumOfSquaresScalar(data + endBlock * kIndexBlock, end - endBlock * kIndexBlock) -
+           sumOfSquaresScalar(data + startBlock * kIndexBlock, start - startBlock * kIndexBlock);
+}
+
+int16_t PrefixIndex::query(uint32_t start, uint32_t end) const {
+    if (start > end || end > values.size()) {
+        return kInvalidRange;
+    }
+    uint64_t sum = sumOfSquares(start, end);
+    return sum > 32767 ? 32767 : static_cast<int16_t>(sum);
+}
+
+bool VectorStore::fits(const std::string& login, size_t count) const {
+    if (count > capacity - elements) {
+        return false;
+    }
+    auto owned = vectors.find(login);
+    size_t used = owned == vectors.end() ? 0 : owned->second.elements;
+    return count <= loginQuota - used;
+}
+
+bool VectorStore::admits(const std::string& login, size_t count) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fits(login, count);
+}
+
+uint32_t VectorStore::store(const std::string& login, std::vector<int16_t> values) {
+    size_t count = values.size();
+    // Индекс строится вне блокировки: загрузка длинной записи не задерживает запросы
+    std::shared_ptr<const PrefixIndex> index = std::make_shared<PrefixIndex>(std::move(values));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fits(login, count)) {
+        return 0;
+    }
+    Owned& owned = vectors[login];
+    owned.vectors.push_back(std::move(index));
+    owned.elements += count;
+    elements += count;
+    return static_cast<uint32_t>(owned.vectors.size());
+}
+
+std::shared_ptr<const PrefixIndex> VectorStore::find(const std::string& login, uint32_t handle) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto owned = vectors.find(login);
+    if (owned == vectors.end() || handle == 0 || handle > owned->second.vectors.size()) {
+        return nullptr;
+    }
+    return owned->second.vectors[handle - 1];
+}
+
+size_t VectorStore::storedElements() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return elements;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file rangeindex.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Векторы, хранимые на сервере, и запросы суммы квадратов по диапазонам.
+ * @details Клиент один раз загружает длинный вектор (запись) и получает его
+ *          номер, а затем в одном запросе спрашивает суммы квадратов многих
+ *          диапазонов [start, end). При загрузке строится блочный индекс:
+ *          64-битные префиксные суммы квадратов на границах блоков по
+ *          kIndexBlock элементов. Ответ на диапазон — разность двух префиксов
+ *          и поправки по неполным блокам на концах, то есть не больше
+ *          2 * kIndexBlock элементов независимо от длины диапазона.
+ */
+
+#ifndef RANGEINDEX_H
+#define RANGEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Элементов в блоке индекса.
+static const size_t kIndexBlock = 16;
+
+/// Наибольшее количество элементов во всех хранимых векторах (256 МиБ данных).
+static const size_t kMaxStoredElements = 128u * 1024 * 1024;
+
+/// Наибольшее количество элементов в векторах одного логина (32 МиБ данных).
+static const size_t kMaxStoredElementsPerLogin = 16u * 1024 * 1024;
+
+/// Ответ на диапазон, выходящий за вектор или с start > end.
+static const int16_t kInvalidRange = -1;
+
+/**
+ * @brief Хранимый вектор с блочным индексом префиксных сумм квадратов.
+ */
+class PrefixIndex {
+public:
+    /**
+     * @brief Забирает элементы и строит индекс.
+     * @param values Элементы вектора.
+     */
+    explicit PrefixIndex(std::vector<int16_t> values);
+
+    /**
+     * @brief Возвращает точную сумму квадратов элементов [start, end).
+     * @details Диапазон должен лежать внутри вектора (start <= end <= size()).
+     */
+    uint64_t sumOfSquares(size_t start, size_t end) const;
+
+    /**
+     * @brief Возвращает насыщенную сумму квадратов диапазона (как у обычных векторов).
+     * @return Сумма, не больше 32767, или kInvalidRange для некорректного диапазона.
+     */
+    int16_t query(uint32_t start, uint32_t end) const;
+
+    /**
+     * @brief Возвращает количество элементов.
+     */
+    size_t size() const { return values.size(); }
+
+private:
+    std::vector<int16_t> values;  ///< Элементы вектора
+    std::vector<uint64_t> prefix; ///< prefix[k] — сумма квадратов первых k * kIndexBlock элементов
+};
+
+/**
+ * @brief Сумма квадратов одного полного блока индекса.
+ * @param values kIndexBlock элементов.
+ */
+uint64_t blockSumOfSquares(const int16_t* values);
+
+/**
+ * @brief Хранимые векторы пользователей.
+ * @details Номера векторов выдаются отдельно для каждого логина, начиная с 1:
+ *          пользователь видит только свои записи. Векторы не удаляются и живут
+ *          до перезапуска сервера, поэтому объем ограничен квотой каждого
+ *          логина: один пользователь не может занять все хранилище.
+ */
+class VectorStore {
+public:
+    /**
+     * @brief Конструктор.
+     * @param loginQuota Наибольшее количество элементов одного логина.
+     * @param capacity Наибольшее количество элементов всего хранилища.
+     */
+    explicit VectorStore(size_t loginQuota = kMaxStoredElementsPerLogin, size_t capacity = kMaxStoredElements)
+        : loginQuota(loginQuota), capacity(capacity) {}
+
+    /**
+     * @brief Проверяет, поместится ли вектор пользователя.
+     * @param login Владелец.
+     * @param count Количество элементов.
+     */
+    bool admits(const std::string& login, size_t count) const;
+
+    /**
+     * @brief Сохраняет вектор и строит его индекс.
+     * @param login Владелец.
+     * @param values Элементы.
+     * @return Номер вектора или 0, если превышена квота логина или общий объем хранилища.
+     */
+    uint32_t store(const std::string& login, std::vector<int16_t> values);
+
+    /**
+     * @brief Возвращает вектор пользователя по номеру.
+     * @return nullptr если такого вектора нет.
+     */
+    std::shared_ptr<const PrefixIndex> find(const std::string& login, uint32_t handle) const;
+
+    /**
+     * @brief Возвращает количество элементов во всех хранимых векторах.
+     */
+    size_t storedElements() const;
+
+private:
+    /**
+     * @brief Векторы одного логина.
+     */
+    struct Owned {
+        std::vector<std::shared_ptr<const PrefixIndex>> vectors; ///< Векторы по номерам - 1
+        size_t elements = 0;                                   ///< Элементов в векторах логина
+    };
+
+    size_t loginQuota;                               ///< Квота логина, элементов
+    size_t capacity;                                 ///< Объем хранилища, элементов
+    mutable std::mutex mutex;                        ///< Доступ из нескольких потоков
+    std::unordered_map<std::string, Owned> vectors;  ///< Векторы по логинам
+    size_t elements = 0;                             ///< Всего элементов
+
+    /**
+     * @brief Проверяет квоту и объем (вызывается под mutex).
+     */
+    bool fits(const std::string& login, size_t count) const;
+};
+
+#endif // RANGEINDEX_H
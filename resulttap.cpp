@@ -0,0 +1,159 @@
+/**
+ * @file resulttap.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация кольца результатов в разделяемой памяти.
+ */
+
+#include "resulttap.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Возвращает размер отображения для кольца.
+ */
+static size_t ringSize(uint32_t capacity) {
+    return sizeof(TapHeader) + static_cast<size_t>(capacity) * sizeof(TapSlot);
+}
+
+ResultTap::ResultTap(const std::string& name, uint32_t capacity) : name(name), capacity(2) {
+    while (this->capacity < capacity) {
+        this->capacity <<= 1;
+    }
+}
+
+ResultTap::~ResultTap() {
+    if (!header) {
+        return;
+    }
+    header->live.store(0, std::memory_order_release);
+    munmap(header, mappedSize);
+    shm_unlink(name.c_str());
+}
+
+bool ResultTap::open(bool replaceStale) {
+    // Без явного разрешения существующее кольцо не трогаем: его мог создать работающий сервер
+    if (replaceStale) {
+        shm_unlink(name.c_str());
+    }
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        return false;
+    }
+    mappedSize = ringSize(capacity);
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(mappedSize)) == 0) {
+        mapping = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // ftruncate() обнуляет память: head и номера слотов уже равны нулю
+    header = static_cast<TapHeader*>(mapping);
+    slots = reinterpret_cast<TapSlot*>(static_cast<uint8_t*>(mapping) + sizeof(TapHeader));
+    header->magic = kTapMagic;
+    header->capacity = capacity;
+    header->slotSize = sizeof(TapSlot);
+    header->live.store(1, std::memory_order_release);
+    return true;
+}
+
+void ResultTap::publish(const ResultRecord& record) {
+    if (!header) {
+        return;
+    }
+    uint64_t sequence = header->head.fetch_add(1, std::memory_order_relaxed);
+    TapSlot& slot = slots[sequence & (capacity - 1)];
+
+    // Протокол seqlock: номер 0 на время записи, затем номер записи + 1
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.record, &record, sizeof(record));
+    slot.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+ResultTapReader::ResultTapReader(const std::string& name) : name(name) {}
+
+ResultTapReader::~ResultTapReader() {
+    if (header) {
+        munmap(const_cast<TapHeader*>(header), mappedSize);
+    }
+}
+
+bool ResultTapReader::open(bool fromOldest) {
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(TapHeader)) {
+        mappedSize = static_cast<size_t>(info.st_size);
+        mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const TapHeader* ring = static_cast<const TapHeader*>(mapping);
+    uint32_t capacity = ring->capacity;
+    if (ring->magic != kTapMagic || ring->slotSize != sizeof(TapSlot) || capacity == 0 ||
+        (capacity & (capacity - 1)) != 0 || mappedSize < ringSize(capacity)) {
+        munmap(mapping, mappedSize);
+        return false;
+    }
+
+    header = ring;
+    slots = reinterpret_cast<const TapSlot*>(static_cast<const uint8_t*>(mapping) + sizeof(TapHeader));
+    mask = capacity - 1;
+    position = header->head.load(std::memory_order_acquire);
+    if (fromOldest) {
+        position = position > capacity ? position - capacity : 0;
+    }
+    return true;
+}
+
+TapRead ResultTapReader::next(ResultRecord& record) {
+    if (!header) {
+        return TapRead::Closed;
+    }
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if (position >= head) {
+        return header->live.load(std::memory_order_acquire) ? TapRead::Empty : TapRead::Closed;
+    }
+
+    const TapSlot& slot = slots[position & mask];
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    bool lapped = head - position > mask + 1 || before > position + 1;
+    if (!lapped) {
+        if (before != position + 1) {
+            // Запись занята писателем, но еще не опубликована
+            return TapRead::Empty;
+        }
+        std::memcpy(&record, &slot.record, sizeof(record));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        lapped = slot.sequence.load(std::memory_order_relaxed) != before;
+    }
+    if (lapped) {
+        // Слот уже перезаписан: переходим к самой старой записи кольца
+        head = header->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > mask + 1 ? head - (mask + 1) : 0;
+        if (oldest > position) {
+            missed += oldest - position;
+            position = oldest;
+        } else {
+            ++missed;
+            ++position;
+        }
+        return TapRead::Lapped;
+    }
+    ++position;
+    return TapRead::Record;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file resulttap.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Кольцо результатов в разделяемой памяти для локальных потребителей.
+ * @details Сервер дописывает записи ResultRecord в кольцо POSIX shm, а
+ *          локальные потребители отображают его только для чтения и копируют
+ *          записи из слотов, каждый в своем темпе, без системных вызовов.
+ *          Объект создается с правами 0640, как журнал результатов: читать
+ *          результаты могут только пользователь и группа сервера.
+ *          Каждый слот несет номер записи: потребитель, которого сервер
+ *          обогнал на целый круг, видит в слоте более новый номер и узнает,
+ *          сколько записей пропустил. Сервер потребителей не ждет и о них
+ *          ничего не знает.
+ */
+
+#ifndef RESULTTAP_H
+#define RESULTTAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "journal.h"
+
+/// Количество слотов кольца по умолчанию (степень двойки).
+static const uint32_t kTapCapacity = 65536;
+
+/// Метка формата в заголовке кольца ("SCTP").
+static const uint32_t kTapMagic = 0x50544353;
+
+/**
+ * @brief Заголовок кольца в начале разделяемой памяти.
+ */
+struct TapHeader {
+    uint32_t magic;                      ///< kTapMagic
+    uint32_t capacity;                   ///< Количество слотов
+    uint32_t slotSize;                   ///< sizeof(TapSlot)
+    std::atomic<uint32_t> live;          ///< 1 — сервер пишет в кольцо
+    alignas(64) std::atomic<uint64_t> head; ///< Номер следующей записи
+};
+
+/**
+ * @brief Слот кольца (одна строка кэша).
+ * @details sequence = номер записи + 1 после публикации и 0, пока слот
+ *          перезаписывается; потребитель проверяет номер до и после чтения.
+ */
+struct alignas(64) TapSlot {
+    std::atomic<uint64_t> sequence;      ///< Номер опубликованной записи + 1
+    ResultRecord record;                 ///< Запись
+};
+
+static_assert(sizeof(TapSlot) == 64, "TapSlot must fill one cache line");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be lock-free across processes");
+
+/**
+ * @brief Писатель кольца (сервер).
+ */
+class ResultTap {
+public:
+    /**
+     * @brief Конструктор.
+     * @param name Имя объекта shm ("/scale-results").
+     * @param capacity Количество слотов (округляется вверх до степени двойки).
+     */
+    ResultTap(const std::string& name, uint32_t capacity = kTapCapacity);
+
+    /**
+     * @brief Деструктор: помечает кольцо закрытым и удаляет имя объекта.
+     */
+    ~ResultTap();
+
+    ResultTap(const ResultTap&) = delete;
+    ResultTap& operator=(const ResultTap&) = delete;
+
+    /**
+     * @brief Создает объект разделяемой памяти (права 0640) и отображает его.
+     * @param replaceStale true — сначала удалить объект с тем же именем,
+     *        оставшийся от аварийно завершенного сервера.
+     * @return false если объект не создан; errno == EEXIST — имя уже занято
+     *         (возможно, кольцом другого работающего сервера).
+     */
+    bool open(bool replaceStale = false);
+
+    /**
+     * @brief Публикует запись (из любого потока, без блокировок и системных вызовов).
+     * @param record Запись о результате.
+     */
+    void publish(const ResultRecord& record);
+
+    /**
+     * @brief Возвращает количество опубликованных записей.
+     */
+    uint64_t getPublished() const { return header ? header->head.load(std::memory_order_relaxed) : 0; }
+
+private:
+    std::string name;            ///< Имя объекта shm
+    uint32_t capacity;           ///< Количество слотов
+    size_t mappedSize = 0;       ///< Размер отображения
+    TapHeader* header = nullptr; ///< Заголовок кольца
+    TapSlot* slots = nullptr;    ///< Слоты
+};
+
+/**
+ * @brief Итог чтения из кольца.
+ */
+enum class TapRead {
+    Record,  ///< Прочитана следующая запись
+    Empty,   ///< Новых записей нет
+    Lapped,  ///< Сервер обогнал потребителя: часть записей потеряна
+    Closed   ///< Сервер закрыл кольцо и все записи прочитаны
+};
+
+/**
+ * @brief Потребитель кольца (отображение только для чтения).
+ */
+class ResultTapReader {
+public:
+    /**
+     * @brief Конструктор.
+     * @param name Имя объекта shm.
+     */
+    explicit ResultTapReader(const std::string& name);
+
+    /**
+     * @brief Деструктор: снимает отображение.
+     */
+    ~ResultTapReader();
+
+    ResultTapReader(const ResultTapReader&) = delete;
+    ResultTapReader& operator=(const ResultTapReader&) = delete;
+
+    /**
+     * @brief Отображает кольцо и встает на текущую позицию сервера.
+     * @param fromOldest true — начать с самой старой записи, еще лежащей в кольце.
+     * @return false если кольца нет или формат не совпал.
+     */
+    bool open(bool fromOldest = false);
+
+    /**
+     * @brief Читает следующую запись.
+     * @param record Запись (заполняется при TapRead::Record).
+     * @return Итог чтения; после TapRead::Lapped потребитель уже перенесен
+     *         на самую старую запись кольца, а getMissed() учитывает пропуск.
+     */
+    TapRead next(ResultRecord& record);
+
+    /**
+     * @brief Возвращает количество записей, потерянных из-за отставания.
+     */
+    uint64_t getMissed() const { return missed; }
+
+private:
+    std::string name;                  ///< Имя объекта shm
+    size_t mappedSize = 0;             ///< Размер отображения
+    const TapHeader* header = nullptr; ///< Заголовок кольца
+    const TapSlot* slots = nullptr;    ///< Слоты
+    uint64_t mask = 0;                 ///< capacity - 1
+    uint64_t position = 0;             ///< Номер следующей читаемой записи
+    uint64_t missed = 0;               ///< Потеряно записей
+};
+
+#endif // RESULTTAP_H
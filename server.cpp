@@ -8,6 +8,13 @@
  */
 
 #include "server.h"
+#include "journal.h"
+#include "resulttap.h"
+#include "tls.h"
+#include "eventloop.h"
+#include "workerpool.h"
+#include "sockettune.h"
+#include "hmacauth.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -15,13 +22,25 @@
 #include <cstring>
 #include <ctime>
 #include <iomanip>
+#include <algorithm>
 #include <random>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <openssl/evp.h>
 #include <cstdlib>
+#include <cerrno>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+/// Первый дескриптор, передаваемый при активации через сокет (SD_LISTEN_FDS_START).
+static const int kListenFdsStart = 3;
+
+/// Длина очереди ожидающих подключений: клиенты ждут в ней, пока сервер стартует.
+static const int kListenBacklog = SOMAXCONN;
 
 /**
  * @brief Конструктор класса Server.
@@ -32,6 +51,17 @@
 Server::Server(int port, const std::string& userDbPath, const std::string& logPath)
     : port(port), userDbPath(userDbPath), logPath(logPath) {}
 
+Server::~Server() {
+    {
+        std::lock_guard<std::mutex> lock(hmacMutex);
+        hmacStopping = true;
+    }
+    hmacQueued.notify_all();
+    if (hmacDeriver.joinable()) {
+        hmacDeriver.join();
+    }
+}
+
 /**
  * @brief Загружает базу данных пользователей из файла.
  * @details Читает файл построчно, парсит строки формата "логин:пароль"
@@ -52,6 +82,21 @@ void Server::loadUserDatabase() {
             std::string password = line.substr(pos + 1);
             if (!login.empty() && !password.empty()) {
                 users[login] = password;
+                
+                // Ключ из пароля выводится при первом входе в режиме HMAC: PBKDF2 для всей базы замедлял бы запуск
+                if (!isDerivedKeyEntry(password)) {
+                    continue;
+                }
+                std::string key;
+                parseDerivedKey(password, key);
+                if (key.empty()) {
+                    logError("Invalid HMAC key for login: " + login, true);
+                    continue;
+                }
+                if (!hmacKeys[login].init(key)) {
+                    hmacKeys.erase(login);
+                    logError("Cannot prepare HMAC key for login: " + login, true);
+                }
             }
         }
     }
@@ -62,21 +107,132 @@ void Server::loadUserDatabase() {
  * @brief Записывает сообщение об ошибке в файл журнала.
  * @param message Текст сообщения об ошибке.
  * @param isCritical Флаг критичности ошибки.
+ * @return true если запись выполнена, false если файл журнала не открылся.
  */
-void Server::logError(const std::string& message, bool isCritical) {
+bool Server::logError(const std::string& message, bool isCritical) {
+    std::lock_guard<std::mutex> lock(logMutex);
     std::ofstream logFile(logPath, std::ios::app);
     if (!logFile.is_open()) {
-        return;
+        return false;
     }
     
     std::time_t now = std::time(nullptr);
-    std::tm* timeinfo = std::localtime(&now);
+    std::tm timeinfo;
+    localtime_r(&now, &timeinfo);
     
-    logFile << std::put_time(timeinfo, "%Y-%m-%d %H:%M:%S") << " | "
+    logFile << std::put_time(&timeinfo, "%Y-%m-%d %H:%M:%S") << " | "
             << (isCritical ? "CRITICAL" : "NON-CRITICAL") << " | "
             << message << std::endl;
     
     logFile.close();
+    return true;
+}
+
+/**
+ * @brief Создает каталоги на пути к файлу журнала.
+ * @details Заменяет прежний вызов system("mkdir -p ..."), который порождал
+ *          процесс оболочки при каждом запуске.
+ */
+void Server::ensureLogDirectory() {
+    size_t slash = logPath.find_last_of('/');
+    if (slash == std::string::npos || slash == 0) {
+        return;
+    }
+    
+    std::string directory = logPath.substr(0, slash);
+    for (size_t pos = directory.find('/', 1); ; pos = directory.find('/', pos + 1)) {
+        std::string prefix = directory.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return;
+        }
+        if (pos == std::string::npos) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Возвращает слушающий сокет по протоколу активации systemd.
+ * @return Дескриптор 3 при LISTEN_PID == getpid() и LISTEN_FDS >= 1, иначе -1.
+ */
+int Server::socketActivationFd() {
+    const char* listenPid = std::getenv("LISTEN_PID");
+    const char* listenFds = std::getenv("LISTEN_FDS");
+    if (!listenPid || !listenFds) {
+        return -1;
+    }
+    
+    bool ownedByUs = std::strtol(listenPid, nullptr, 10) == static_cast<long>(getpid());
+    long count = std::strtol(listenFds, nullptr, 10);
+    
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    
+    if (!ownedByUs || count < 1) {
+        return -1;
+    }
+    return kListenFdsStart;
+}
+
+/**
+ * @brief Возвращает готовый слушающий сокет.
+ * @return Дескриптор слушающего сокета или -1 при ошибке.
+ * @details Унаследованный дескриптор проверяется на то, что это TCP-сокет
+ *          в состоянии listen; иначе создается и привязывается новый сокет.
+ */
+int Server::openListenSocket() {
+    if (listenSocket >= 0) {
+        int accepting = 0;
+        int type = 0;
+        socklen_t length = sizeof(accepting);
+        bool valid = getsockopt(listenSocket, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &length) == 0;
+        length = sizeof(type);
+        valid = valid && getsockopt(listenSocket, SOL_SOCKET, SO_TYPE, &type, &length) == 0;
+        if (!valid || !accepting || type != SOCK_STREAM) {
+            logError("Inherited descriptor " + std::to_string(listenSocket) +
+                     " is not a listening stream socket", true);
+            return -1;
+        }
+        return listenSocket;
+    }
+    
+    // Создаем сокет
+    int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket < 0) {
+        logError("Cannot create socket", true);
+        return -1;
+    }
+    
+    // Устанавливаем опции сокета
+    int opt = 1;
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        logError("Cannot set socket options", true);
+        close(serverSocket);
+        return -1;
+    }
+    
+    // Настраиваем адрес сервера
+    sockaddr_in serverAddr;
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    serverAddr.sin_port = htons(port);
+    
+    // Привязываем сокет к адресу
+    if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        logError("Cannot bind socket to port " + std::to_string(port), true);
+        close(serverSocket);
+        return -1;
+    }
+    
+    // Начинаем прослушивание
+    if (listen(serverSocket, kListenBacklog) < 0) {
+        logError("Cannot listen on socket", true);
+        close(serverSocket);
+        return -1;
+    }
+    
+    return serverSocket;
 }
 
 /**
@@ -145,38 +301,40 @@ std::string Server::generateSalt() {
 /**
  * @brief Аутентифицирует клиента по протоколу SHA-224 с солью.
  * @param clientSocket Дескриптор сокета клиента.
+ * @param login Логин клиента (заполняется при успехе).
  * @return true если аутентификация успешна, false в противном случае.
  */
-bool Server::authenticate(int clientSocket) {
+bool Server::authenticate(int clientSocket, std::string& login) {
     char buffer[256];
     
     // Шаг 2: Клиент передает свой идентификатор LOGIN
-    ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+    ssize_t bytesRead = clientRecv(clientSocket, buffer, sizeof(buffer) - 1, 0);
     if (bytesRead <= 0) {
         logError("No data received from client for login", false);
         return false;
     }
     buffer[bytesRead] = '\0';
-    std::string login(buffer);
+    login = buffer;
+    bool hmac = takeHmacPrefix(login);
     
     // Шаг 3: Проверяем идентификацию
     auto userIt = users.find(login);
     if (userIt == users.end()) {
         // 3б. Ошибка идентификации - отправляем ERR и разрываем соединение
-        send(clientSocket, "ERR", 3, 0);
+        clientSend(clientSocket, "ERR", 3, 0);
         logError("Identification failed for login: " + login, false);
         return false;
     }
     
     // 3а. Успешная идентификация - отправляем соль (16 hex символов)
     std::string salt = generateSalt();
-    if (send(clientSocket, salt.c_str(), 16, 0) != 16) {
+    if (clientSend(clientSocket, salt.c_str(), 16, 0) != 16) {
         logError("Failed to send salt to client", false);
         return false;
     }
     
     // Шаг 4: Клиент передает HASH(SALT || PASSWORD)
-    bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+    bytesRead = clientRecv(clientSocket, buffer, sizeof(buffer) - 1, 0);
     if (bytesRead <= 0) {
         logError("No hash received from client", false);
         return false;
@@ -185,54 +343,167 @@ bool Server::authenticate(int clientSocket) {
     std::string receivedHash(buffer);
     
     // Шаг 5: Проверяем аутентификацию
-    std::string password = userIt->second;
-    std::string computedHash = sha224Hash(salt + password);
-    
-    // Приводим к верхнему регистру для сравнения
-    for (auto& c : receivedHash) c = std::toupper(c);
-    
-    if (computedHash == receivedHash) {
+    if (hmac ? verifyHmac(login, salt, receivedHash) : verifyHash(login, salt, receivedHash)) {
         // 5а. Успешная аутентификация
-        send(clientSocket, "OK", 2, 0);
+        clientSend(clientSocket, "OK", 2, 0);
         logError("Authentication successful for login: " + login, false);
         return true;
     } else {
         // 5б. Ошибка аутентификации - отправляем ERR и разрываем соединение
-        send(clientSocket, "ERR", 3, 0);
+        clientSend(clientSocket, "ERR", 3, 0);
         logError("Authentication failed for login: " + login, false);
         return false;
     }
 }
 
 /**
- * @brief Вычисляет сумму квадратов элементов вектора с проверкой переполнения.
- * @param vector Вектор 16-битных целых чисел.
- * @return Сумма квадратов элементов вектора.
- * @details При переполнении вверх возвращает 32767 (2^15),
- *          при переполнении вниз возвращает -32768 (-2^15).
+ * @brief Проверяет ответ клиента HASH(SALT || PASSWORD).
+ * @param login Логин клиента.
+ * @param salt Выданная соль.
+ * @param receivedHash Принятый хэш.
+ * @return true если логин известен и хэш совпал.
  */
-int16_t Server::calculateSumOfSquares(const std::vector<int16_t>& vector) {
-    if (vector.empty()) {
-        return 0;
+bool Server::verifyHash(const std::string& login, const std::string& salt, std::string receivedHash) {
+    auto userIt = users.find(login);
+    // Для записи с ключом пароля нет: такой пользователь входит только через HMAC
+    if (userIt == users.end() || isDerivedKeyEntry(userIt->second)) {
+        return false;
     }
     
-    // Используем int64_t для предотвращения переполнения
-    int64_t sum = 0;
+    std::string computedHash = sha224Hash(salt + userIt->second);
     
-    for (int16_t value : vector) {
-        int64_t square = static_cast<int64_t>(value) * static_cast<int64_t>(value);
-        sum += square;
-        
-        // Проверка переполнения
-        if (sum > 32767) {
-            return 32767;
+    // Приводим к верхнему регистру для сравнения
+    for (auto& c : receivedHash) c = std::toupper(c);
+    
+    return computedHash == receivedHash;
+}
+
+/**
+ * @brief Проверяет ответ клиента HMAC-SHA224(K, SALT).
+ * @param login Логин клиента.
+ * @param salt Выданная соль.
+ * @param receivedMac Принятый ответ.
+ * @return true если для логина есть ключ и ответ совпал.
+ */
+bool Server::verifyHmac(const std::string& login, const std::string& salt, const std::string& receivedMac) {
+    const HmacKey* key = findHmacKey(login);
+    if (!key) {
+        key = prepareHmacKey(login);
+    }
+    return key && key->verify(salt, receivedMac);
+}
+
+/**
+ * @brief Выводит и запоминает ключ HMAC пользователя с паролем в базе.
+ * @param login Логин клиента.
+ * @return Ключ или nullptr, если логин неизвестен или ключ не удалось подготовить.
+ * @details PBKDF2 выполняется вне блокировки: вход одного пользователя не
+ *          задерживает проверку остальных. Если ключ одновременно вывели
+ *          два цикла, остается первый.
+ */
+const HmacKey* Server::prepareHmacKey(const std::string& login) {
+    auto userIt = users.find(login);
+    if (userIt == users.end() || isDerivedKeyEntry(userIt->second)) {
+        return nullptr;
+    }
+    HmacKey key;
+    if (!key.init(deriveHmacKey(login, userIt->second))) {
+        logError("Cannot prepare HMAC key for login: " + login, true);
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(hmacMutex);
+    // Узлы unordered_map не перемещаются: указатель действует, пока жив сервер
+    return &hmacKeys.emplace(login, std::move(key)).first->second;
+}
+
+/**
+ * @brief Ставит ключ HMAC пользователя в очередь вывода.
+ * @param login Логин клиента.
+ * @param waiter Цикл, ждущий ключ (nullptr — не ждет).
+ * @return true если waiter получит уведомление о завершении вывода.
+ * @details PBKDF2 занимает миллисекунды: в цикле epoll это задержало бы все
+ *          его подключения, поэтому ключ выводит отдельный поток.
+ */
+bool Server::awaitHmacKey(const std::string& login, EventLoop* waiter) {
+    std::lock_guard<std::mutex> lock(hmacMutex);
+    if (hmacKeys.count(login)) {
+        return false;
+    }
+    auto pendingIt = hmacPending.find(login);
+    if (pendingIt == hmacPending.end()) {
+        auto userIt = users.find(login);
+        if (userIt == users.end() || isDerivedKeyEntry(userIt->second)) {
+            return false;
         }
-        if (sum < -32768) {
-            return -32768;
+        pendingIt = hmacPending.emplace(login, std::vector<EventLoop*>()).first;
+        hmacQueue.push_back(login);
+        if (!hmacDeriver.joinable()) {
+            hmacDeriver = std::thread(&Server::deriveHmacKeys, this);
         }
+        hmacQueued.notify_one();
+    }
+    if (!waiter) {
+        return false;
+    }
+    std::vector<EventLoop*>& waiters = pendingIt->second;
+    if (std::find(waiters.begin(), waiters.end(), waiter) == waiters.end()) {
+        waiters.push_back(waiter);
+    }
+    return true;
+}
+
+bool Server::hmacKeyDerived(const std::string& login) {
+    std::lock_guard<std::mutex> lock(hmacMutex);
+    return hmacPending.find(login) == hmacPending.end();
+}
+
+const HmacKey* Server::findHmacKey(const std::string& login) {
+    std::lock_guard<std::mutex> lock(hmacMutex);
+    auto keyIt = hmacKeys.find(login);
+    return keyIt == hmacKeys.end() ? nullptr : &keyIt->second;
+}
+
+void Server::forgetHmacWaiter(EventLoop* waiter) {
+    std::lock_guard<std::mutex> lock(hmacMutex);
+    for (auto& pending : hmacPending) {
+        std::vector<EventLoop*>& waiters = pending.second;
+        waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+    }
+}
+
+void Server::deriveHmacKeys() {
+    std::unique_lock<std::mutex> lock(hmacMutex);
+    while (true) {
+        hmacQueued.wait(lock, [this] { return hmacStopping || !hmacQueue.empty(); });
+        if (hmacStopping) {
+            return;
+        }
+        std::string login = std::move(hmacQueue.front());
+        hmacQueue.pop_front();
+        lock.unlock();
+        prepareHmacKey(login);
+        lock.lock();
+
+        // Уведомление под блокировкой: цикл не удаляется, пока forgetHmacWaiter() ждет ее
+        auto pendingIt = hmacPending.find(login);
+        for (EventLoop* waiter : pendingIt->second) {
+            waiter->hmacKeyDerived();
+        }
+        hmacPending.erase(pendingIt);
     }
-    
-    return static_cast<int16_t>(sum);
+}
+
+/**
+ * @brief Вычисляет сумму квадратов элементов вектора с проверкой переполнения.
+ * @param vector Вектор 16-битных целых чисел.
+ * @return Сумма квадратов элементов вектора.
+ * @details Тот же SquareSum, что суммирует принимаемые векторы в обоих
+ *          режимах; при переполнении возвращает 32767.
+ */
+int16_t Server::calculateSumOfSquares(const std::vector<int16_t>& vector) {
+    SquareSum square;
+    square.add(reinterpret_cast<const uint8_t*>(vector.data()), vector.size() * sizeof(int16_t));
+    return square.result();
 }
 
 /**
@@ -247,7 +518,7 @@ bool Server::readExact(int socket, void* buffer, size_t size) {
     size_t totalRead = 0;
     
     while (totalRead < size) {
-        ssize_t bytesRead = recv(socket, buf + totalRead, size - totalRead, 0);
+        ssize_t bytesRead = clientRecv(socket, buf + totalRead, size - totalRead, 0);
         if (bytesRead <= 0) {
             return false;
         }
@@ -259,90 +530,393 @@ bool Server::readExact(int socket, void* buffer, size_t size) {
 /**
  * @brief Обрабатывает передачу векторов от аутентифицированного клиента.
  * @param clientSocket Дескриптор сокета клиента.
- * @details Ожидает данные в двоичном формате согласно ТЗ.
+ * @param login Логин клиента (для журнала результатов).
+ * @details Ожидает данные в двоичном формате согласно ТЗ. При включенном
+ *          журнале каждый результат ставится в группу на фиксацию; в строгом
+ *          режиме результаты копятся в очереди отправки и уходят клиенту
+ *          после одного ожидания fdatasync() на всю очередь: когда прием
+ *          должен ждать новых данных, очередь заполнена или пакет закончен.
  */
-void Server::processVectors(int clientSocket) {
-    std::cout << "DEBUG: Starting vector processing" << std::endl;
-    
+void Server::processVectors(int clientSocket, const std::string& login) {
     // Шаг 6: Читаем количество векторов
+    pulse("read-count", clientSocket);
+    // Поле читается целиком: запись TLS может закончиться посреди него
     uint32_t numVectors;
-    ssize_t bytesRead = recv(clientSocket, &numVectors, sizeof(numVectors), 0);
-    
-    std::cout << "DEBUG: Read " << bytesRead << " bytes for numVectors" << std::endl;
-    
-    if (bytesRead != sizeof(numVectors)) {
-        std::cout << "DEBUG: Failed to read numVectors. Expected " << sizeof(numVectors) 
-                  << ", got " << bytesRead << std::endl;
+    if (!readExact(clientSocket, &numVectors, sizeof(numVectors))) {
         logError("Failed to read number of vectors", false);
         return;
     }
     
     // КЛИЕНТ ОТПРАВЛЯЕТ В LITTLE-ENDIAN - оставляем как есть
-    std::cout << "DEBUG: Number of vectors: " << numVectors << std::endl;
+    
+    // Хранимые векторы: загрузка записи или запрос по ее диапазонам вместо пакета
+    uint32_t requestFlags = numVectors & ~kRequestCountMask;
+    if (requestFlags & (kStoreVectorFlag | kRangeQueryFlag)) {
+        if (requestFlags == kStoreVectorFlag) {
+            storeVector(clientSocket, login);
+        } else if (requestFlags == kRangeQueryFlag) {
+            answerRanges(clientSocket, login, numVectors & kRequestCountMask);
+        } else {
+            logError("Invalid combination of request flags: " + std::to_string(requestFlags), false);
+        }
+        return;
+    }
+    
+    // Необязательный срок пакета: после него ответы клиенту уже не нужны
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    if (numVectors & kBatchDeadlineFlag) {
+        numVectors &= ~kBatchDeadlineFlag;
+        uint32_t deadlineMs;
+        if (!readExact(clientSocket, &deadlineMs, sizeof(deadlineMs))) {
+            logError("Failed to read batch deadline", false);
+            return;
+        }
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(deadlineMs);
+    }
+    bool hasDeadline = deadline != std::chrono::steady_clock::time_point::max();
+    
+    // Прием с опережением и неблокирующая отправка; TLS в OpenSSL читает только блокирующе
+    bool overlap = !clientTls || clientTls->isKernelOffloaded();
+    if (!receivePipeline) {
+        receivePipeline = std::make_unique<ReceivePipeline>();
+    }
+    ReceivePipeline& pipeline = *receivePipeline;
+    pipeline.reset([this, clientSocket](void* buffer, size_t size, int flags) {
+        return clientRecv(clientSocket, buffer, size, flags);
+    }, overlap);
+    SendQueue output([this, clientSocket](const void* buffer, size_t size, int flags) {
+        return clientSend(clientSocket, buffer, size, flags | MSG_NOSIGNAL);
+    }, overlap);
+    
+    // Уже принятые байты означают, что клиент на связи: сокет опрашивается, только когда буферы пусты
+    auto batchCancelled = [&](uint32_t vectorsLeft, int timeoutMs) {
+        BatchCancel reason = BatchCancel::None;
+        if (pipeline.buffered() == 0) {
+            reason = checkBatch(clientSocket, deadline, timeoutMs);
+        } else if (std::chrono::steady_clock::now() >= deadline) {
+            reason = BatchCancel::Deadline;
+        }
+        if (reason != BatchCancel::None) {
+            cancelBatch(reason, vectorsLeft);
+            return true;
+        }
+        return false;
+    };
+    
+    // Строгий журнал: последняя запись, результат которой ждет в очереди фиксации группы
+    uint64_t unsyncedSequence = 0;
+    auto resultsDurable = [&]() {
+        if (unsyncedSequence == 0) {
+            return true;
+        }
+        bool durable = journal->waitDurable(unsyncedSequence);
+        unsyncedSequence = 0;
+        if (!durable) {
+            logError("Result journal write failed, pending results not acknowledged", true);
+        }
+        return durable;
+    };
+    // Перед блокирующим приемом результаты фиксируются и уходят клиенту: он может ждать их,
+    // прежде чем слать дальше. Пока сокет не принимает результаты, ждем либо места в нем, либо данных
+    auto flushBeforeWait = [&]() {
+        if (pipeline.buffered() > 0) {
+            return true;
+        }
+        pipeline.drain();
+        if (pipeline.buffered() > 0) {
+            return true;
+        }
+        if (!resultsDurable()) {
+            return false;
+        }
+        while (output.pending() > 0) {
+            if (!output.flush(false)) {
+                logError("Failed to send pending results", false);
+                return false;
+            }
+            if (output.pending() == 0) {
+                break;
+            }
+            int timeoutMs = -1;
+            if (hasDeadline) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                timeoutMs = static_cast<int>(std::max<long long>(0, std::min<long long>(left + 1, 1 << 30)));
+            }
+            pollfd descriptor{clientSocket, POLLIN | POLLOUT, 0};
+            // Пришли данные или истек срок: дальше решает прием или проверка срока
+            if (poll(&descriptor, 1, timeoutMs) <= 0 || (descriptor.revents & ~POLLOUT)) {
+                break;
+            }
+        }
+        return true;
+    };
     
     // Обрабатываем каждый вектор и сразу отправляем результат
     for (uint32_t i = 0; i < numVectors; ++i) {
-        std::cout << "DEBUG: Processing vector " << i + 1 << std::endl;
+        // Результаты отправляются до ожидания срока: клиент может ждать их, прежде чем слать дальше
+        if (!flushBeforeWait()) {
+            cancelBatch(BatchCancel::Disconnect, numVectors - i);
+            return;
+        }
+        if (hasDeadline && batchCancelled(numVectors - i, -1)) {
+            return;
+        }
         
         // Шаг 7: Читаем размер вектора
+        pulse("read-vector", clientSocket);
         uint32_t vectorSize;
-        bytesRead = recv(clientSocket, &vectorSize, sizeof(vectorSize), 0);
-        
-        std::cout << "DEBUG: Read " << bytesRead << " bytes for vectorSize" << std::endl;
-        
-        if (bytesRead != sizeof(vectorSize)) {
-            std::cout << "DEBUG: Failed to read vectorSize" << std::endl;
+        if (!pipeline.read(&vectorSize, sizeof(vectorSize))) {
             logError("Failed to read vector size", false);
+            cancelBatch(BatchCancel::Disconnect, numVectors - i);
             return;
         }
         
-        // КЛИЕНТ ОТПРАВЛЯЕТ В LITTLE-ENDIAN - оставляем как есть
-        std::cout << "DEBUG: Vector " << i + 1 << " size: " << vectorSize << std::endl;
-        
-        // Шаг 8: Читаем данные вектора
-        std::vector<int16_t> vector(vectorSize);
-        size_t totalBytesToRead = vectorSize * sizeof(int16_t);
+        // Объем пакета известен после первого размера: подбираем буферы сокета
+        if (i == 0 && socketTuning) {
+            tuneSocketBuffers(clientSocket, numVectors, vectorSize, metrics);
+        }
         
-        // Читаем частями если нужно
-        uint8_t* buffer = reinterpret_cast<uint8_t*>(vector.data());
-        size_t totalRead = 0;
+        // Большой вектор вычисляем, только если результат еще кому-то нужен
+        if (vectorSize >= kCancelCheckElements && batchCancelled(numVectors - i, 0)) {
+            return;
+        }
         
-        while (totalRead < totalBytesToRead) {
-            bytesRead = recv(clientSocket, buffer + totalRead, totalBytesToRead - totalRead, 0);
-            if (bytesRead <= 0) {
-                std::cout << "DEBUG: Failed to read vector data" << std::endl;
+        // Шаг 8: Принимаем данные вектора и суммируем их фрагментами по мере приема;
+        // между фрагментами забираем из сокета следующие данные и отправляем готовые результаты
+        size_t bytesLeft = static_cast<size_t>(vectorSize) * sizeof(int16_t);
+        SquareSum square;
+        while (bytesLeft > 0) {
+            if (!flushBeforeWait()) {
+                cancelBatch(BatchCancel::Disconnect, numVectors - i);
+                return;
+            }
+            if (hasDeadline && batchCancelled(numVectors - i, -1)) {
+                return;
+            }
+            // Сторож должен отличать ожидание клиента от долгого вычисления
+            if (pipeline.buffered() == 0) {
+                pulse("read-vector", clientSocket);
+            }
+            const uint8_t* data;
+            size_t size = pipeline.next(data, std::min(bytesLeft, kComputeChunk));
+            if (size == 0) {
                 logError("Failed to read vector data", false);
+                cancelBatch(BatchCancel::Disconnect, numVectors - i);
+                return;
+            }
+            bytesLeft -= size;
+            pulse("compute", clientSocket);
+            square.add(data, size);
+            
+            pipeline.drain();
+            if (unsyncedSequence == 0 && !output.flush(false)) {
+                logError("Failed to send result for vector " + std::to_string(i), false);
+                cancelBatch(BatchCancel::Disconnect, numVectors - i);
                 return;
             }
-            totalRead += bytesRead;
         }
         
-        std::cout << "DEBUG: Read " << totalRead << " bytes of vector data" << std::endl;
+        int16_t result = square.result();
+        metrics.vectorsProcessed++;
         
-        // КЛИЕНТ ОТПРАВЛЯЕТ В LITTLE-ENDIAN - оставляем как есть
-        if (!vector.empty()) {
-            std::cout << "DEBUG: First value: " << vector[0] << std::endl;
+        // Фиксируем результат в журнале до подтверждения клиенту
+        if (journal) {
+            pulse("journal", clientSocket);
+            uint64_t sequence = journal->append(ResultRecord::make(login, vectorSize, result));
+            if (sequence == 0) {
+                logError("Result journal write failed, result for vector " +
+                         std::to_string(i + 1) + " not acknowledged", true);
+                if (resultsDurable()) {
+                    output.flush(true);
+                }
+                return;
+            }
+            if (journalStrict) {
+                unsyncedSequence = sequence;
+            }
         }
         
-        // Вычисляем сумму квадратов
-        int16_t result = calculateSumOfSquares(vector);
-        std::cout << "DEBUG: Sum of squares for vector " << i + 1 << ": " << result << std::endl;
-        
-        // Шаг 9: Отправляем результат СРАЗУ в LITTLE-ENDIAN
-        ssize_t bytesSent = send(clientSocket, &result, sizeof(result), 0);
-        
-        std::cout << "DEBUG: Sent " << bytesSent << " bytes for result: " << result << std::endl;
+        // Локальные потребители читают результат из разделяемой памяти, а не по сети
+        if (resultTap) {
+            resultTap->publish(ResultRecord::make(login, vectorSize, result));
+        }
         
-        if (bytesSent != sizeof(result)) {
-            std::cout << "DEBUG: Failed to send result" << std::endl;
+        // Шаг 9: Отправляем результат СРАЗУ в LITTLE-ENDIAN; то, что сокет не принял, ждет в очереди
+        pulse("send-result", clientSocket);
+        output.push(&result, sizeof(result));
+        bool queueFull = output.pending() >= kMaxPendingOutput;
+        if (queueFull && !resultsDurable()) {
+            return;
+        }
+        if (unsyncedSequence == 0 && !output.flush(queueFull)) {
             logError("Failed to send result for vector " + std::to_string(i + 1), false);
+            cancelBatch(BatchCancel::Disconnect, numVectors - i - 1);
             return;
         }
+    }
+    
+    pulse("send-result", clientSocket);
+    if (!resultsDurable()) {
+        return;
+    }
+    if (!output.flush(true)) {
+        logError("Failed to send result for vector " + std::to_string(numVectors), false);
+        return;
+    }
+}
+
+/**
+ * @brief Принимает вектор для хранения и строит его индекс.
+ * @param clientSocket Дескриптор сокета клиента.
+ * @param login Владелец вектора.
+ */
+void Server::storeVector(int clientSocket, const std::string& login) {
+    pulse("read-vector", clientSocket);
+    uint32_t vectorSize;
+    if (!readExact(clientSocket, &vectorSize, sizeof(vectorSize))) {
+        logError("Failed to read vector size", false);
+        return;
+    }
+    // Запись, которая не поместится, не принимаем вовсе: иначе ее пришлось бы держать в памяти
+    uint32_t handle = 0;
+    if (vectorStore.admits(login, vectorSize)) {
+        std::vector<int16_t> vector(vectorSize);
+        if (!readExact(clientSocket, vector.data(), vector.size() * sizeof(int16_t))) {
+            logError("Failed to read vector data", false);
+            return;
+        }
+        pulse("index", clientSocket);
+        handle = vectorStore.store(login, std::move(vector));
+    }
+    if (handle == 0) {
+        logError("Vector store quota exceeded for login: " + login + ", vector of " +
+                 std::to_string(vectorSize) + " elements rejected", false);
+    } else {
+        metrics.vectorsStored++;
+    }
+    
+    pulse("send-result", clientSocket);
+    if (clientSend(clientSocket, &handle, sizeof(handle), MSG_NOSIGNAL) != sizeof(handle)) {
+        logError("Failed to send stored vector number", false);
+    }
+}
+
+/**
+ * @brief Отвечает на запрос по диапазонам хранимого вектора.
+ * @param clientSocket Дескриптор сокета клиента.
+ * @param login Владелец вектора.
+ * @param rangeCount Количество диапазонов.
+ */
+void Server::answerRanges(int clientSocket, const std::string& login, uint32_t rangeCount) {
+    // Диапазоны читаются и отвечаются частями: запрос может быть сколь угодно длинным
+    const size_t kRangeChunk = 4096;
+    
+    pulse("read-count", clientSocket);
+    uint32_t handle;
+    if (!readExact(clientSocket, &handle, sizeof(handle))) {
+        logError("Failed to read stored vector number", false);
+        return;
+    }
+    // Неизвестный номер не обрывает протокол: клиент получает ответ на каждый диапазон
+    std::shared_ptr<const PrefixIndex> index = vectorStore.find(login, handle);
+    if (!index) {
+        logError("Unknown stored vector " + std::to_string(handle) + " for login: " + login, false);
+    }
+    
+    std::vector<uint32_t> bounds(2 * std::min<size_t>(rangeCount, kRangeChunk));
+    std::vector<int16_t> results(bounds.size() / 2);
+    uint32_t answered = 0;
+    while (answered < rangeCount) {
+        size_t chunk = std::min<size_t>(rangeCount - answered, kRangeChunk);
+        pulse("read-vector", clientSocket);
+        if (!readExact(clientSocket, bounds.data(), chunk * 2 * sizeof(uint32_t))) {
+            logError("Failed to read ranges", false);
+            return;
+        }
+        pulse("compute", clientSocket);
+        for (size_t i = 0; i < chunk; ++i) {
+            results[i] = index ? index->query(bounds[2 * i], bounds[2 * i + 1]) : kInvalidRange;
+        }
+        if (index) {
+            metrics.rangesAnswered += chunk;
+        }
         
-        std::cout << "DEBUG: Result for vector " << i + 1 << " sent successfully" << std::endl;
+        pulse("send-result", clientSocket);
+        size_t bytes = chunk * sizeof(int16_t);
+        if (clientSend(clientSocket, results.data(), bytes, MSG_NOSIGNAL) != static_cast<ssize_t>(bytes)) {
+            logError("Failed to send range results", false);
+            return;
+        }
+        answered += static_cast<uint32_t>(chunk);
+    }
+}
+
+/**
+ * @brief Проверяет, ждет ли клиент еще результаты пакета.
+ * @param socket Сокет клиента.
+ * @param deadline Срок пакета.
+ * @param timeoutMs Время ожидания данных (-1 — до срока пакета).
+ * @return Причина отмены или BatchCancel::None.
+ */
+Server::BatchCancel Server::checkBatch(int socket, std::chrono::steady_clock::time_point deadline,
+                                       int timeoutMs) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+        return BatchCancel::Deadline;
+    }
+    if (clientTls && clientTls->pending() > 0) {
+        return BatchCancel::None;
+    }
+    if (timeoutMs < 0 && deadline != std::chrono::steady_clock::time_point::max()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        timeoutMs = static_cast<int>(std::min<long long>(left + 1, 1 << 30));
     }
     
-    std::cout << "DEBUG: All " << numVectors << " vectors processed successfully" << std::endl;
+    pollfd descriptor{socket, POLLIN | POLLRDHUP, 0};
+    int ready = poll(&descriptor, 1, timeoutMs);
+    if (ready == 0) {
+        return timeoutMs == 0 ? BatchCancel::None : BatchCancel::Deadline;
+    }
+    if (ready > 0 && (descriptor.revents & (POLLRDHUP | POLLHUP | POLLERR))) {
+        int pending = 0;
+        if (ioctl(socket, FIONREAD, &pending) < 0 || pending == 0) {
+            return BatchCancel::Disconnect;
+        }
+    }
+    return BatchCancel::None;
+}
+
+/**
+ * @brief Принимает данные от текущего клиента (через TLS, если он включен).
+ */
+ssize_t Server::clientRecv(int socket, void* buffer, size_t size, int flags) {
+    return clientTls ? clientTls->recv(socket, buffer, size, flags) : recv(socket, buffer, size, flags);
+}
+
+/**
+ * @brief Отправляет данные текущему клиенту (через TLS, если он включен).
+ */
+ssize_t Server::clientSend(int socket, const void* buffer, size_t size, int flags) {
+    return clientTls ? clientTls->send(socket, buffer, size, flags)
+                     : send(socket, buffer, size, flags | MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Учитывает отмену пакета в счетчиках и журнале.
+ * @param reason Причина отмены.
+ * @param vectorsLeft Векторы пакета, оставшиеся без ответа.
+ */
+void Server::cancelBatch(BatchCancel reason, uint32_t vectorsLeft) {
+    if (reason == BatchCancel::Deadline) {
+        metrics.batchesCancelledDeadline++;
+    } else {
+        metrics.batchesCancelledDisconnect++;
+    }
+    metrics.vectorsCancelled += vectorsLeft;
+    logError(std::string("Batch cancelled (") +
+             (reason == BatchCancel::Deadline ? "deadline expired" : "client disconnected") +
+             "), vectors dropped: " + std::to_string(vectorsLeft), false);
 }
 
 /**
@@ -353,98 +927,162 @@ void Server::handleClient(int clientSocket) {
     std::cout << "New client connection" << std::endl;
     logError("New client connection established", false);
     
-    if (!authenticate(clientSocket)) {
-        logError("Authentication failed, closing connection", false);
-        close(clientSocket);
-        return;
+    // Шифрованный транспорт: рукопожатие до обмена логином
+    TlsSession tlsSession;
+    if (tls) {
+        pulse("tls-handshake", clientSocket);
+        if (!tls->accept(clientSocket, tlsSession)) {
+            logError("TLS handshake failed", false);
+            close(clientSocket);
+            return;
+        }
+        clientTls = &tlsSession;
+        if (tlsSession.isKernelOffloaded()) {
+            metrics.tlsSessionsKernel++;
+        } else {
+            metrics.tlsSessionsUser++;
+        }
     }
     
-    std::cout << "Client authenticated successfully" << std::endl;
-    logError("Client authenticated successfully", false);
+    std::string login;
+    pulse("authenticate", clientSocket);
+    if (authenticate(clientSocket, login)) {
+        std::cout << "Client authenticated successfully" << std::endl;
+        logError("Client authenticated successfully", false);
+        processVectors(clientSocket, login);
+    } else {
+        logError("Authentication failed, closing connection", false);
+    }
     
-    processVectors(clientSocket);
+    if (clientTls) {
+        tlsSession.shutdown();
+        clientTls = nullptr;
+    }
     close(clientSocket);
     logError("Client connection closed", false);
+    
+    if (!metricsPath.empty()) {
+        metrics.writeTo(metricsPath);
+    }
+}
+
+/**
+ * @brief Запускает сторож зависаний, если задан порог.
+ * @details Стек зависшего потока дописывается в лог-файл через отдельный
+ *          дескриптор: обработчик сигнала не может брать мьютекс лога.
+ */
+void Server::startWatchdog() {
+    if (watchdogThresholdMs <= 0) {
+        return;
+    }
+    int traceFd = open(logPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    watchdog = std::make_unique<Watchdog>(metrics, watchdogThresholdMs,
+                                          [this](const std::string& message) { logError(message, true); },
+                                          traceFd);
+    watchdog->start();
+    logError("Watchdog enabled, stall threshold: " + std::to_string(watchdogThresholdMs) + " ms", false);
+}
+
+/**
+ * @brief Переносит код и горячие данные на большие страницы.
+ * @details Выполняется до загрузки базы пользователей и до запуска потоков
+ *          обработки; при любой неудаче сегмент остается отображением файла.
+ */
+void Server::mapHugePages() {
+    for (const HugePageRemap& remap : remapExecutableToHugePages()) {
+        if (remap.remapped) {
+            metrics.hugePageBytes += remap.bytes;
+            logError(std::string("Segment ") + remap.segment + " remapped onto huge pages: " +
+                     std::to_string(remap.bytes / 1024) + " KiB", false);
+        } else {
+            logError(std::string("Segment ") + remap.segment + " left on regular pages: " + remap.reason, false);
+        }
+    }
+    if (!reserveHugePageHeap(kHugePageSize)) {
+        logError("User table left in regular heap: huge pages unavailable", false);
+    }
 }
 
 /**
  * @brief Запускает основной цикл работы сервера.
  * @return true если сервер успешно запущен, false при критической ошибке.
+ * @details Слушающий сокет получается первым: с этого момента ядро ставит
+ *          подключения в очередь, а остальная инициализация (журнал, база
+ *          пользователей) выполняется до первого accept().
  */
 bool Server::start() {
-    // Проверяем возможность записи в лог-файл
-    std::ofstream testLog(logPath, std::ios::app);
-    if (!testLog.is_open()) {
+    int serverSocket = openListenSocket();
+    if (serverSocket < 0) {
+        std::cerr << "ERROR: Cannot obtain listening socket" << std::endl;
+        return false;
+    }
+    
+    // Проверяем возможность записи в лог-файл (первая запись служит проверкой)
+    ensureLogDirectory();
+    if (!logError("=== Server starting ===", false)) {
         std::cerr << "ERROR: Cannot open log file: " << logPath << std::endl;
         // Пробуем альтернативный путь
         logPath = "./server_fallback.log";
         std::cerr << "Trying fallback: " << logPath << std::endl;
-        testLog.open(logPath, std::ios::app);
-        if (!testLog.is_open()) {
+        if (!logError("=== Server starting ===", false)) {
             std::cerr << "ERROR: Cannot open fallback log file" << std::endl;
+            close(serverSocket);
             return false;
         }
     }
-    testLog.close();
     
-    logError("=== Server starting ===", false);
+    // Код и база пользователей переносятся на большие страницы до начала обработки
+    if (hugePages) {
+        mapHugePages();
+    }
     
     // Загружаем базу пользователей
     loadUserDatabase();
     logError("User database loaded, users: " + std::to_string(users.size()), false);
-    
-    // Создаем директорию для логов если её нет
-    system("mkdir -p log 2>/dev/null");
+    if (hugePageHeapUsed() > 0) {
+        logError("User table on huge pages: " + std::to_string(hugePageHeapUsed()) + " bytes", false);
+    }
     
     // Инициализация OpenSSL
     OpenSSL_add_all_digests();
     
-    // Создаем сокет
-    int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket < 0) {
-        logError("Cannot create socket", true);
-        return false;
-    }
+    startWatchdog();
     
-    // Устанавливаем опции сокета
-    int opt = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        logError("Cannot set socket options", true);
-        close(serverSocket);
-        return false;
-    }
+    std::cout << "Server started on port " << port << std::endl;
+    std::cout << "User database: " << userDbPath << std::endl;
+    std::cout << "Log file: " << logPath << std::endl;
+    std::cout << "Press Ctrl+C to stop" << std::endl;
     
-    // Настраиваем адрес сервера
-    sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(port);
+    if (serverSocket == listenSocket) {
+        logError("Server started on inherited socket " + std::to_string(serverSocket), false);
+    } else {
+        logError("Server started successfully on port " + std::to_string(port), false);
+    }
     
-    // Привязываем сокет к адресу
-    if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        logError("Cannot bind socket to port " + std::to_string(port), true);
+    // Событийный режим: подключения обслуживает цикл epoll (или пул циклов)
+    if (eventDriven && workers > 1) {
+        logError("Event-driven mode enabled, workers: " + std::to_string(workers), false);
+        WorkerPool pool(*this, serverSocket, workers, rebalanceIntervalMs);
+        bool ok = pool.run();
         close(serverSocket);
-        return false;
+        return ok;
     }
-    
-    // Начинаем прослушивание
-    if (listen(serverSocket, 10) < 0) {
-        logError("Cannot listen on socket", true);
+    if (eventDriven) {
+        logError("Event-driven mode enabled", false);
+        EventLoop loop(*this, serverSocket);
+        bool ok = loop.run();
         close(serverSocket);
-        return false;
+        return ok;
     }
     
-    std::cout << "Server started on port " << port << std::endl;
-    std::cout << "User database: " << userDbPath << std::endl;
-    std::cout << "Log file: " << logPath << std::endl;
-    std::cout << "Press Ctrl+C to stop" << std::endl;
-    
-    logError("Server started successfully on port " + std::to_string(port), false);
-    
     // Основной цикл обработки подключений
+    heartbeat = watchdog ? watchdog->attach("main") : nullptr;
     while (true) {
         sockaddr_in clientAddr;
         socklen_t clientLen = sizeof(clientAddr);
+        if (heartbeat) {
+            heartbeat->idle();
+        }
         int clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientLen);
         
         if (clientSocket < 0) {
@@ -457,6 +1095,10 @@ bool Server::start() {
         std::cout << "Client connected from " << clientIP << ":" << ntohs(clientAddr.sin_port) << std::endl;
         
         // Обрабатываем клиента в текущем потоке (однопоточный режим по ТЗ)
+        metrics.connectionsAccepted++;
+        if (socketTuning) {
+            applyNotSentLowat(clientSocket);
+        }
         handleClient(clientSocket);
     }
     
@@ -14,6 +14,39 @@
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include "metrics.h"
+#include "watchdog.h"
+#include "hugepages.h"
+#include "hmacauth.h"
+#include "rangeindex.h"
+#include "pipeline.h"
+
+/// Флаг в поле количества векторов: за полем следует срок пакета (uint32_t, мс).
+static const uint32_t kBatchDeadlineFlag = 0x80000000u;
+
+/// Флаг в поле количества векторов: сохранить следующий вектор на сервере (ответ — uint32_t номер).
+static const uint32_t kStoreVectorFlag = 0x40000000u;
+
+/// Флаг в поле количества векторов: младшие биты — число диапазонов к хранимому вектору.
+static const uint32_t kRangeQueryFlag = 0x20000000u;
+
+/// Младшие биты поля количества: число векторов или диапазонов без флагов.
+static const uint32_t kRequestCountMask = ~(kBatchDeadlineFlag | kStoreVectorFlag | kRangeQueryFlag);
+
+/// Векторы от этого размера вычисляются, только если клиент еще на связи.
+static const uint32_t kCancelCheckElements = 4096;
+
+class ResultJournal;
+class ResultTap;
+class EventLoop;
+class TlsContext;
+class TlsSession;
 
 /**
  * @brief Класс сервера для обработки клиентских подключений.
@@ -31,28 +64,229 @@ public:
      */
     Server(int port, const std::string& userDbPath, const std::string& logPath);
     
+    /**
+     * @brief Деструктор: останавливает поток вывода ключей HMAC.
+     */
+    ~Server();
+    
     /**
      * @brief Запускает сервер и начинает прослушивание порта.
      * @return true если сервер успешно запущен, false при ошибке.
      */
     bool start();
 
+    /**
+     * @brief Задает уже привязанный слушающий сокет, унаследованный от родителя.
+     * @param fd Дескриптор слушающего сокета (-1 — создать сокет самостоятельно).
+     * @details Используется при активации через сокет (systemd, LISTEN_FDS) и при
+     *          перезапуске с передачей дескриптора: ядро продолжает ставить
+     *          подключения в очередь, пока процесс сервера стартует.
+     */
+    void setListenSocket(int fd) { listenSocket = fd; }
+
+    /**
+     * @brief Возвращает слушающий сокет, переданный по протоколу systemd.
+     * @return Дескриптор сокета (SD_LISTEN_FDS_START = 3) или -1, если
+     *         переменные LISTEN_PID/LISTEN_FDS не заданы для этого процесса.
+     * @details Переменные окружения удаляются, чтобы не передаться дочерним процессам.
+     */
+    static int socketActivationFd();
+
+    /**
+     * @brief Подключает журнал результатов.
+     * @param resultJournal Журнал (nullptr — не вести журнал); владение не передается.
+     * @param strict true — результат отправляется клиенту только после фиксации на диске.
+     */
+    void setJournal(ResultJournal* resultJournal, bool strict) {
+        journal = resultJournal;
+        journalStrict = strict;
+    }
+
+    /**
+     * @brief Подключает кольцо результатов для локальных потребителей.
+     * @param tap Кольцо (nullptr — не публиковать); владение не передается.
+     */
+    void setResultTap(ResultTap* tap) { resultTap = tap; }
+
+    /**
+     * @brief Включает событийный режим (epoll) вместо последовательного.
+     * @param enabled true — обслуживать множество подключений одновременно.
+     */
+    void setEventDriven(bool enabled) { eventDriven = enabled; }
+
+    /**
+     * @brief Задает число потоков-обработчиков событийного режима.
+     * @param count Количество циклов epoll (1 — один цикл в текущем потоке).
+     * @param intervalMs Период перераспределения подключений между циклами, мс (0 — отключено).
+     */
+    void setWorkers(size_t count, int intervalMs) {
+        workers = count;
+        rebalanceIntervalMs = intervalMs;
+    }
+
+    /**
+     * @brief Включает общие проходы для крошечных векторов разных подключений.
+     * @param lanes Дорожек в проходе (0 — отключено).
+     * @param windowUs Окно накопления, мкс.
+     * @details Действует только в событийном режиме.
+     */
+    void setMicroBatch(size_t lanes, int windowUs) {
+        batchLanes = lanes;
+        batchWindowUs = windowUs;
+    }
+
+    /**
+     * @brief Включает шифрованный транспорт для всех подключений.
+     * @param context Контекст TLS (nullptr — открытый TCP); владение не передается.
+     * @details Поддерживается только последовательный режим: рукопожатие
+     *          выполняется на блокирующем сокете.
+     */
+    void setTls(TlsContext* context) { tls = context; }
+
+    /**
+     * @brief Включает подбор буферов сокета под пакет клиента.
+     * @param enabled false — оставить размеры буферов ядра по умолчанию.
+     */
+    void setSocketTuning(bool enabled) { socketTuning = enabled; }
+
+    /**
+     * @brief Включает сторож зависаний циклов обработки.
+     * @param stallThresholdMs Порог зависания, мс (0 — сторож отключен).
+     */
+    void setWatchdog(int stallThresholdMs) { watchdogThresholdMs = stallThresholdMs; }
+
+    /**
+     * @brief Включает перенос кода и базы пользователей на большие страницы при запуске.
+     * @param enabled true — переносить.
+     */
+    void setHugePages(bool enabled) { hugePages = enabled; }
+
+    /**
+     * @brief Задает файл, в который выгружаются счетчики сервера.
+     * @param path Путь к файлу (пустая строка — не выгружать).
+     */
+    void setMetricsPath(const std::string& path) { metricsPath = path; }
+
+    /**
+     * @brief Возвращает счетчики сервера.
+     */
+    const ServerMetrics& getMetrics() const { return metrics; }
+
 private:
+    friend class EventLoop;
+
     int port;                                       ///< Порт сервера
+    int listenSocket = -1;                          ///< Унаследованный слушающий сокет (-1 — нет)
+    ResultJournal* journal = nullptr;               ///< Журнал результатов (nullptr — отключен)
+    ResultTap* resultTap = nullptr;                 ///< Кольцо результатов для локальных потребителей
+    bool journalStrict = false;                     ///< Ждать фиксации перед отправкой результата
+    bool eventDriven = false;                       ///< Событийный режим (epoll)
+    bool socketTuning = true;                       ///< Подбирать SO_RCVBUF/SO_SNDBUF и TCP_NOTSENT_LOWAT
+    bool hugePages = false;                         ///< Переносить код и горячие данные на большие страницы
+    int watchdogThresholdMs = 0;                    ///< Порог зависания для сторожа, мс (0 — отключен)
+    std::unique_ptr<Watchdog> watchdog;             ///< Сторож зависаний
+    Heartbeat* heartbeat = nullptr;                 ///< Пульс последовательного цикла
+    size_t workers = 1;                             ///< Потоки-обработчики событийного режима
+    int rebalanceIntervalMs = 100;                  ///< Период балансировки циклов, мс
+    size_t batchLanes = 0;                          ///< Дорожек общего прохода (0 — отключено)
+    int batchWindowUs = 0;                          ///< Окно накопления дорожек, мкс
+    std::mutex logMutex;                            ///< Порядок строк лога из нескольких потоков
+    std::string metricsPath;                        ///< Файл счетчиков (пусто — не выгружать)
+    ServerMetrics metrics;                          ///< Счетчики сервера
+    TlsContext* tls = nullptr;                      ///< Контекст TLS (nullptr — открытый TCP)
+    TlsSession* clientTls = nullptr;                ///< TLS-соединение текущего клиента
+    
+    /**
+     * @brief Причина отмены пакета.
+     */
+    enum class BatchCancel {
+        None,       ///< Клиент ждет результат
+        Deadline,   ///< Истек срок пакета
+        Disconnect  ///< Клиент отключился
+    };
+    
+    /**
+     * @brief Ждет данных от клиента не дольше срока пакета.
+     * @param socket Сокет клиента.
+     * @param deadline Срок пакета (time_point::max() — без срока).
+     * @param timeoutMs Сколько ждать данных (-1 — до срока пакета).
+     * @return Причина отмены или BatchCancel::None, если клиент еще нужен.
+     * @details Отключением считается закрытие клиентом своей стороны, когда
+     *          непрочитанных данных не осталось: дописать пакет он уже не сможет.
+     */
+    BatchCancel checkBatch(int socket, std::chrono::steady_clock::time_point deadline, int timeoutMs);
+    
+    /**
+     * @brief Учитывает и журналирует отмену пакета.
+     * @param reason Причина отмены.
+     * @param vectorsLeft Сколько векторов пакета осталось без ответа.
+     */
+    void cancelBatch(BatchCancel reason, uint32_t vectorsLeft);
+    
+    /**
+     * @brief Отмечает в пульсе последовательного цикла новый этап работы.
+     * @param stage Этап (строковый литерал).
+     * @param connection Сокет клиента.
+     */
+    void pulse(const char* stage, int connection) {
+        if (heartbeat) {
+            heartbeat->beat(stage, connection);
+        }
+    }
+    
+    /**
+     * @brief Запускает сторож зависаний, если он включен.
+     */
+    void startWatchdog();
+    
+    /**
+     * @brief Переносит код и данные только для чтения на большие страницы
+     *        и резервирует для базы пользователей область больших страниц.
+     */
+    void mapHugePages();
+    
     std::string userDbPath;                         ///< Путь к базе пользователей
     std::string logPath;                            ///< Путь к файлу журнала
-    std::unordered_map<std::string, std::string> users; ///< Кэш пользователей (логин:пароль)
+    /// Кэш пользователей (логин:пароль); при -H лежит на больших страницах
+    std::unordered_map<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>,
+                       HugePageAllocator<std::pair<const std::string, std::string>>> users;
+    std::unordered_map<std::string, HmacKey> hmacKeys; ///< Подготовленные ключи HMAC (логин:ключ), только добавляются
+    std::mutex hmacMutex;                           ///< Доступ к hmacKeys и очереди вывода ключей
+    std::deque<std::string> hmacQueue;              ///< Логины, ключи которых ждут вывода
+    /// Выводимые ключи и циклы, ждущие их (nullptr — ключ выводится заранее)
+    std::unordered_map<std::string, std::vector<EventLoop*>> hmacPending;
+    std::condition_variable hmacQueued;             ///< В очереди вывода появился логин
+    bool hmacStopping = false;                      ///< Запрошена остановка потока вывода
+    std::thread hmacDeriver;                        ///< Поток вывода ключей событийного режима
+    VectorStore vectorStore;                        ///< Векторы, хранимые для запросов по диапазонам
+    std::unique_ptr<ReceivePipeline> receivePipeline; ///< Буферы приема последовательного режима
     
     /**
      * @brief Записывает сообщение об ошибке в журнал.
      * @param message Текст сообщения об ошибке.
      * @param isCritical Флаг критичности ошибки (true для критических).
+     * @return true если запись выполнена, false если журнал недоступен.
+     */
+    bool logError(const std::string& message, bool isCritical);
+    
+    /**
+     * @brief Создает каталог файла журнала (аналог mkdir -p без запуска оболочки).
      */
-    void logError(const std::string& message, bool isCritical);
+    void ensureLogDirectory();
+    
+    /**
+     * @brief Возвращает слушающий сокет: унаследованный либо созданный заново.
+     * @return Дескриптор слушающего сокета или -1 при ошибке.
+     */
+    int openListenSocket();
     
     /**
      * @brief Загружает базу данных пользователей из файла.
-     * @details Формат файла: каждая строка содержит "логин:пароль".
+     * @details Формат файла: каждая строка содержит "логин:пароль" либо
+     *          "логин:$k$<hex>" (ключ HMAC вместо пароля). Сразу готовятся
+     *          только ключи записей $k$; ключ из пароля выводится при первом
+     *          входе пользователя в режиме HMAC (prepareHmacKey()), в
+     *          событийном режиме — в отдельном потоке (awaitHmacKey()).
      */
     void loadUserDatabase();
     
@@ -78,18 +312,75 @@ private:
     /**
      * @brief Аутентифицирует клиента по протоколу SHA-224.
      * @param clientSocket Дескриптор сокета клиента.
+     * @param login Логин аутентифицированного клиента (заполняется при успехе).
      * @return true если аутентификация успешна.
      * @details Протокол:
-     *          1. Клиент отправляет логин
+     *          1. Клиент отправляет логин (с префиксом "HMAC:" — режим HMAC)
      *          2. Сервер генерирует и отправляет соль (16 hex символов)
-     *          3. Клиент отправляет HASH(SALT || PASSWORD)
-     *          4. Сервер проверяет хэш
+     *          3. Клиент отправляет HASH(SALT || PASSWORD) либо HMAC-SHA224(K, SALT)
+     *          4. Сервер проверяет ответ
+     */
+    bool authenticate(int clientSocket, std::string& login);
+    
+    /**
+     * @brief Проверяет ответ клиента на выданную соль.
+     * @param login Логин клиента.
+     * @param salt Выданная соль (16 hex символов).
+     * @param receivedHash Принятый HASH(SALT || PASSWORD) в любом регистре.
+     * @return true если логин известен и хэш совпал.
+     */
+    bool verifyHash(const std::string& login, const std::string& salt, std::string receivedHash);
+    
+    /**
+     * @brief Проверяет ответ клиента в режиме HMAC.
+     * @param login Логин клиента.
+     * @param salt Выданная соль.
+     * @param receivedMac Принятый HMAC-SHA224(K, SALT) в hex.
+     * @return true если для логина есть ключ и ответ совпал.
+     */
+    bool verifyHmac(const std::string& login, const std::string& salt, const std::string& receivedMac);
+    
+    /**
+     * @brief Выводит из пароля и запоминает ключ HMAC пользователя.
+     * @param login Логин клиента.
+     * @return Ключ или nullptr, если у логина нет пароля в базе.
+     */
+    const HmacKey* prepareHmacKey(const std::string& login);
+    
+    /**
+     * @brief Ставит ключ HMAC пользователя в очередь вывода, не блокируя цикл.
+     * @param login Логин клиента.
+     * @param waiter Цикл, которому сообщить о завершении (nullptr — вывести заранее).
+     * @return true если ключ выводится и waiter получит hmacKeyDerived();
+     *         false если ждать нечего: ключ готов или его не из чего вывести.
+     */
+    bool awaitHmacKey(const std::string& login, EventLoop* waiter);
+    
+    /**
+     * @brief Проверяет, что вывод ключа пользователя завершен (успешно или нет).
+     */
+    bool hmacKeyDerived(const std::string& login);
+    
+    /**
+     * @brief Возвращает готовый ключ HMAC пользователя, не выводя его.
+     * @return Ключ или nullptr.
+     */
+    const HmacKey* findHmacKey(const std::string& login);
+    
+    /**
+     * @brief Снимает цикл со всех ожиданий вывода ключей (перед его удалением).
      */
-    bool authenticate(int clientSocket);
+    void forgetHmacWaiter(EventLoop* waiter);
+    
+    /**
+     * @brief Основной цикл потока вывода ключей.
+     */
+    void deriveHmacKeys();
     
     /**
      * @brief Обрабатывает передачу векторов от аутентифицированного клиента.
      * @param clientSocket Дескриптор сокета клиента для обмена данными.
+     * @param login Логин клиента (для журнала результатов).
      * @details Ожидает данные в двоичном формате:
      *          - количество векторов (uint32_t)
      *          - для каждого вектора:
@@ -98,15 +389,38 @@ private:
      *          Отправляет результаты в двоичном формате:
      *          - количество результатов (uint32_t)
      *          - результаты (int16_t[])
+     *          Флаги kStoreVectorFlag и kRangeQueryFlag в поле количества
+     *          переключают подключение на storeVector() и answerRanges();
+     *          они не сочетаются друг с другом и со сроком пакета.
+     */
+    void processVectors(int clientSocket, const std::string& login);
+
+    /**
+     * @brief Принимает вектор для хранения на сервере.
+     * @details Формат: размер (uint32_t), данные (int16_t[]). Ответ — номер
+     *          вектора (uint32_t), 0 если вектор не помещается в квоту логина
+     *          (kMaxStoredElementsPerLogin) или в хранилище.
+     */
+    void storeVector(int clientSocket, const std::string& login);
+
+    /**
+     * @brief Отвечает на запрос сумм квадратов по диапазонам хранимого вектора.
+     * @param rangeCount Количество диапазонов (младшие биты поля количества).
+     * @details Формат: номер вектора (uint32_t), затем пары start, end
+     *          (uint32_t) полуоткрытых диапазонов. Ответ — int16_t на каждый
+     *          диапазон: сумма квадратов с насыщением до 32767 или
+     *          kInvalidRange для диапазона вне вектора. На запрос к
+     *          неизвестному или чужому номеру диапазоны дочитываются и на
+     *          каждый отвечается kInvalidRange.
      */
-    void processVectors(int clientSocket);
+    void answerRanges(int clientSocket, const std::string& login, uint32_t rangeCount);
     
     /**
      * @brief Вычисляет сумму квадратов элементов вектора.
      * @param vector Вектор 16-битных целых чисел для обработки.
      * @return Сумма квадратов элементов.
-     * @details При переполнении вверх возвращает 32767 (2^15),
-     *          при переполнении вниз возвращает -32768 (-2^15).
+     * @details Целый вектор через SquareSum приема; при переполнении
+     *          возвращает 32767 (2^15).
      */
     int16_t calculateSumOfSquares(const std::vector<int16_t>& vector);
     
@@ -119,6 +433,18 @@ private:
      */
     bool readExact(int socket, void* buffer, size_t size);
     
+    /**
+     * @brief Принимает данные от текущего клиента.
+     * @details При kTLS и открытом TCP — обычный recv(), иначе SSL_read().
+     */
+    ssize_t clientRecv(int socket, void* buffer, size_t size, int flags);
+    
+    /**
+     * @brief Отправляет данные текущему клиенту.
+     * @details При kTLS и открытом TCP — обычный send(), иначе SSL_write().
+     */
+    ssize_t clientSend(int socket, const void* buffer, size_t size, int flags);
+    
     #ifdef SERVER_TESTING
     public:
         /**
@@ -127,6 +453,14 @@ private:
          */
         size_t getUsersCount() const { return users.size(); }
         
+        /**
+         * @brief Возвращает количество подготовленных ключей HMAC.
+         */
+        size_t getHmacKeysCount() {
+            std::lock_guard<std::mutex> lock(hmacMutex);
+            return hmacKeys.size();
+        }
+        
         /**
          * @brief Тестовый метод для вычисления суммы квадратов вектора.
          * @param vector Вектор для обработки.
@@ -159,6 +493,27 @@ private:
         void testLoadUserDatabase() {
             loadUserDatabase();
         }
+        
+        /**
+         * @brief Тестовый метод проверки ответа SHA-224.
+         */
+        bool testVerifyHash(const std::string& login, const std::string& salt, const std::string& hash) {
+            return verifyHash(login, salt, hash);
+        }
+        
+        /**
+         * @brief Тестовый метод проверки ответа HMAC.
+         */
+        bool testVerifyHmac(const std::string& login, const std::string& salt, const std::string& mac) {
+            return verifyHmac(login, salt, mac);
+        }
+        
+        /**
+         * @brief Тестовый метод обработки пакета векторов на готовом сокете.
+         */
+        void testProcessVectors(int socket, const std::string& login) {
+            processVectors(socket, login);
+        }
     #endif
 };
 
@@ -0,0 +1,202 @@
+/**
+ * @file session.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Компактное состояние клиентского подключения и пулы памяти для него.
+ * @details В событийном режиме сервер держит множество подключений, которые
+ *          большую часть времени простаивают. Поэтому состояние подключения
+ *          имеет фиксированный размер (логин и соль хранятся внутри), объекты
+ *          выделяются из slab-пула, а буфер выдается только на время, пока
+ *          по подключению идут данные.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "pipeline.h"
+
+/// Максимальная длина логина, хранимого в сессии (как в ResultRecord).
+static const size_t kSessionLoginSize = 32;
+
+/// Длина соли в шестнадцатеричных символах.
+static const size_t kSessionSaltSize = 16;
+
+/**
+ * @brief Пул объектов одного типа, выделяемых блоками (slab).
+ * @tparam T Тип объекта.
+ * @tparam SlabObjects Количество объектов в одном блоке.
+ * @details Освобожденные объекты возвращаются в список свободных и
+ *          переиспользуются; память блоков возвращается только при
+ *          уничтожении пула. Потокобезопасность обеспечивает владелец.
+ */
+template <typename T, size_t SlabObjects = 1024>
+class SlabPool {
+public:
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    /**
+     * @brief Создает объект в свободном слоте.
+     * @param args Аргументы конструктора T.
+     * @return Указатель на объект.
+     */
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (!freeList) {
+            grow();
+        }
+        Slot* slot = freeList;
+        freeList = slot->next;
+        ++live;
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Уничтожает объект и возвращает слот в пул.
+     * @param object Объект, созданный этим пулом.
+     */
+    void destroy(T* object) {
+        object->~T();
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    /**
+     * @brief Возвращает количество живых объектов.
+     */
+    size_t size() const { return live; }
+
+    /**
+     * @brief Возвращает количество слотов во всех блоках.
+     */
+    size_t capacity() const { return slabs.size() * SlabObjects; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs; ///< Выделенные блоки
+    Slot* freeList = nullptr;                   ///< Список свободных слотов
+    size_t live = 0;                            ///< Живые объекты
+
+    /**
+     * @brief Выделяет новый блок и добавляет его слоты в список свободных.
+     */
+    void grow() {
+        slabs.emplace_back(new Slot[SlabObjects]);
+        Slot* slab = slabs.back().get();
+        for (size_t i = SlabObjects; i-- > 0;) {
+            slab[i].next = freeList;
+            freeList = &slab[i];
+        }
+    }
+};
+
+/**
+ * @brief Пул буферов фиксированного размера.
+ * @details Буфер закрепляется за сессией, пока по ней идут данные (результаты
+ *          ждут отправки), и возвращается, как только они ушли в сокет.
+ */
+class BufferPool {
+public:
+    /// Размер одного буфера.
+    static const size_t kBufferSize = 64 * 1024;
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * @brief Выдает буфер из пула.
+     * @return Буфер размером kBufferSize.
+     */
+    uint8_t* acquire() {
+        if (freeBuffers.empty()) {
+            storage.emplace_back(new uint8_t[kBufferSize]);
+            return storage.back().get();
+        }
+        uint8_t* buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        return buffer;
+    }
+
+    /**
+     * @brief Возвращает буфер в пул.
+     * @param buffer Буфер, полученный через acquire().
+     */
+    void release(uint8_t* buffer) { freeBuffers.push_back(buffer); }
+
+    /**
+     * @brief Возвращает количество выделенных буферов.
+     */
+    size_t allocated() const { return storage.size(); }
+
+    /**
+     * @brief Возвращает количество буферов, закрепленных за сессиями.
+     */
+    size_t inUse() const { return storage.size() - freeBuffers.size(); }
+
+private:
+    std::vector<std::unique_ptr<uint8_t[]>> storage; ///< Все выделенные буферы
+    std::vector<uint8_t*> freeBuffers;               ///< Свободные буферы
+};
+
+/// Значение Session::idleSlot для сессии вне списка простаивающих.
+static const uint32_t kNotIdle = UINT32_MAX;
+
+/**
+ * @brief Этап обработки подключения.
+ */
+enum class SessionStage : uint8_t {
+    ReadLogin,   ///< Ожидание логина
+    ReadHash,    ///< Ожидание HASH(SALT || PASSWORD)
+    ReadCount,   ///< Ожидание количества векторов
+    ReadDeadline, ///< Ожидание срока пакета (если задан флаг kBatchDeadlineFlag)
+    ReadSize,    ///< Ожидание размера очередного вектора
+    ReadData,    ///< Прием элементов вектора
+    Draining,    ///< Пакет обработан, отправляются оставшиеся результаты
+    Closing      ///< Подключение закрыто, объект будет освобожден
+};
+
+/**
+ * @brief Состояние одного подключения в событийном режиме.
+ * @details Все поля фиксированного размера: простаивающая сессия после
+ *          аутентификации не владеет никакой динамической памятью.
+ */
+struct Session {
+    int fd = -1;                                ///< Сокет клиента
+    SessionStage stage = SessionStage::ReadLogin; ///< Текущий этап
+    uint8_t loginLength = 0;                    ///< Длина логина
+    uint8_t headerFill = 0;                     ///< Принято байт заголовка (count/size)
+    uint8_t header[4] = {0};                    ///< Накопитель заголовка
+    char login[kSessionLoginSize] = {0};        ///< Логин (без завершающего нуля при полной длине)
+    char salt[kSessionSaltSize] = {0};          ///< Выданная клиенту соль
+    uint32_t numVectors = 0;                    ///< Векторов в пакете
+    uint32_t vectorIndex = 0;                   ///< Номер текущего вектора
+    uint32_t vectorSize = 0;                    ///< Размер текущего вектора
+    uint32_t elementsLeft = 0;                  ///< Осталось принять элементов
+    SquareSum square;                           ///< Сумма квадратов текущего вектора
+    uint8_t* outbox = nullptr;                  ///< Буфер неотправленных результатов (только пока они есть)
+    uint32_t outboxHead = 0;                    ///< Начало неотправленных данных
+    uint32_t outboxTail = 0;                    ///< Конец неотправленных данных
+    bool awaitingDurable = false;               ///< Результаты ждут фиксации журнала
+    bool hmacAuth = false;                      ///< Клиент выбрал аутентификацию HMAC
+    bool keyAwaited = false;                    ///< Сессия ждала вывода ключа HMAC
+    uint32_t batchedLanes = 0;                  ///< Векторы, ждущие общего прохода (MicroBatch)
+    uint32_t deadlineSlot = 0;                  ///< Позиция в списке сроков цикла
+    uint32_t idleSlot = kNotIdle;               ///< Позиция в списке простаивающих сессий цикла
+    int64_t deadlineMs = 0;                     ///< Срок пакета, мс steady_clock (0 — нет)
+};
+
+#endif // SESSION_H
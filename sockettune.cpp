@@ -0,0 +1,60 @@
+/**
+ * @file sockettune.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация подбора буферов сокета.
+ */
+
+#include "sockettune.h"
+#include "metrics.h"
+#include <algorithm>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+SocketSizing planSocketBuffers(uint32_t numVectors, uint32_t vectorSize) {
+    SocketSizing sizing;
+
+    // Запрос: на каждый вектор поле размера и элементы
+    uint64_t requestBytes = static_cast<uint64_t>(numVectors) *
+                            (sizeof(uint32_t) + static_cast<uint64_t>(vectorSize) * sizeof(int16_t));
+    // Явный SO_RCVBUF отключает автонастройку окна, поэтому задается только
+    // для больших пакетов, которым автонастройка не успевает дать окно
+    if (requestBytes >= kLargeBatchBytes) {
+        sizing.receiveBuffer = static_cast<int>(std::min(requestBytes, kMaxReceiveBuffer));
+    }
+
+    uint64_t resultBytes = static_cast<uint64_t>(numVectors) * sizeof(int16_t);
+    sizing.sendBuffer = static_cast<int>(std::clamp(resultBytes, kMinSendBuffer, kMaxSendBuffer));
+    return sizing;
+}
+
+void applyNotSentLowat(int socket) {
+    int lowat = kNotSentLowat;
+    setsockopt(socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat));
+}
+
+void tuneSocketBuffers(int socket, uint32_t numVectors, uint32_t vectorSize, ServerMetrics& metrics) {
+    SocketSizing sizing = planSocketBuffers(numVectors, vectorSize);
+    if (sizing.receiveBuffer > 0) {
+        setsockopt(socket, SOL_SOCKET, SO_RCVBUF, &sizing.receiveBuffer, sizeof(sizing.receiveBuffer));
+    }
+    setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &sizing.sendBuffer, sizeof(sizing.sendBuffer));
+
+    // В счетчики идут фактические размеры (ядро удваивает и ограничивает запрошенные)
+    int receiveBuffer = 0;
+    int sendBuffer = 0;
+    socklen_t length = sizeof(receiveBuffer);
+    getsockopt(socket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, &length);
+    length = sizeof(sendBuffer);
+    getsockopt(socket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, &length);
+
+    metrics.socketsTuned++;
+    if (sizing.receiveBuffer > 0) {
+        metrics.receiveBuffersSized++;
+    }
+    metrics.receiveBufferBytes += static_cast<uint64_t>(receiveBuffer);
+    metrics.sendBufferBytes += static_cast<uint64_t>(sendBuffer);
+    metrics.lastReceiveBuffer = static_cast<uint64_t>(receiveBuffer);
+    metrics.lastSendBuffer = static_cast<uint64_t>(sendBuffer);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file sockettune.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Подбор буферов сокета под пакет клиента.
+ * @details Размер пакета известен из заголовка: количество векторов и размер
+ *          первого вектора. Клиенту с большими векторами сразу выдается
+ *          приемный буфер на весь пакет (иначе окно растет постепенно), а
+ *          буфер отправки всегда ограничивается объемом результатов, чтобы
+ *          ядро не копило неотправленные данные. TCP_NOTSENT_LOWAT задает,
+ *          сколько неотправленных байт ядро держит, прежде чем сообщить о
+ *          готовности к записи.
+ */
+
+#ifndef SOCKETTUNE_H
+#define SOCKETTUNE_H
+
+#include <cstdint>
+
+struct ServerMetrics;
+
+/// Неотправленные байты, при которых сокет еще считается готовым к записи.
+static const int kNotSentLowat = 4096;
+
+/// Пакет от этого объема получает приемный буфер целиком.
+static const uint64_t kLargeBatchBytes = 256 * 1024;
+
+/// Наибольший приемный буфер (net.core.rmem_max по умолчанию).
+static const uint64_t kMaxReceiveBuffer = 4 * 1024 * 1024;
+
+/// Наименьший буфер отправки (меньше ядро все равно не выделит).
+static const uint64_t kMinSendBuffer = 4608;
+
+/// Наибольший буфер отправки.
+static const uint64_t kMaxSendBuffer = 256 * 1024;
+
+/**
+ * @brief Выбранные размеры буферов.
+ */
+struct SocketSizing {
+    int receiveBuffer = 0;  ///< SO_RCVBUF (0 — оставить автонастройку ядра)
+    int sendBuffer = 0;     ///< SO_SNDBUF
+};
+
+/**
+ * @brief Рассчитывает буферы для пакета.
+ * @param numVectors Количество векторов в пакете.
+ * @param vectorSize Размер первого вектора (элементов).
+ * @return Размеры буферов.
+ */
+SocketSizing planSocketBuffers(uint32_t numVectors, uint32_t vectorSize);
+
+/**
+ * @brief Включает TCP_NOTSENT_LOWAT на сокете клиента.
+ * @param socket Сокет.
+ */
+void applyNotSentLowat(int socket);
+
+/**
+ * @brief Применяет буферы к сокету и учитывает фактические размеры в счетчиках.
+ * @param socket Сокет клиента.
+ * @param numVectors Количество векторов в пакете.
+ * @param vectorSize Размер первого вектора.
+ * @param metrics Счетчики сервера.
+ */
+void tuneSocketBuffers(int socket, uint32_t numVectors, uint32_t vectorSize, ServerMetrics& metrics);
+
+#endif // SOCKETTUNE_H
@@ -5,13 +5,38 @@
 #include <vector>
 #include <iostream>
 #include <cstring>
+#include <cerrno>
 #include <ctime>
 #include <sstream>
 #include <iomanip>
 #include <regex>
+#include <cstdlib>
+#include <unistd.h>
 using namespace std;
 // #define SERVER_TESTING
 #include "server.h"
+#include "proxy.h"
+#include "journal.h"
+#include "session.h"
+#include "metrics.h"
+#include "tls.h"
+#include "handoff.h"
+#include "workerpool.h"
+#include "sockettune.h"
+#include "watchdog.h"
+#include "hugepages.h"
+#include "hmacauth.h"
+#include "resulttap.h"
+#include "microbatch.h"
+#include "rangeindex.h"
+#include "pipeline.h"
+#include "eventloop.h"
+#include <openssl/ssl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <thread>
 // Функция для создания временного файла с пользователями
 string createTempUserDb(const vector<pair<string, string>>& users) {
     string filename = "temp_test_db_" + to_string(time(nullptr)) + ".txt";
@@ -30,6 +55,94 @@ string createTempUserDb(const vector<pair<string, string>>& users) {
 void deleteTempFile(const string& filename) {
     remove(filename.c_str());
 }
+// Функция для отправки всех байт в сокет
+bool sendAll(int socket, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+// Функция для приема ровно size байт из сокета
+bool recvAll(int socket, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = recv(socket, bytes, size, 0);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+// Функция для кодирования пакета векторов (deadlineMs — срок пакета, 0 — без срока;
+// declared — заявленное количество векторов, 0 — по числу переданных)
+vector<uint8_t> encodeBatch(const vector<vector<int16_t>>& vectors, uint32_t deadlineMs = 0, uint32_t declared = 0) {
+    vector<uint8_t> request;
+    auto put = [&request](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        request.insert(request.end(), bytes, bytes + size);
+    };
+    uint32_t count = declared != 0 ? declared : static_cast<uint32_t>(vectors.size());
+    if (deadlineMs != 0) {
+        count |= kBatchDeadlineFlag;
+    }
+    put(&count, sizeof(count));
+    if (deadlineMs != 0) {
+        put(&deadlineMs, sizeof(deadlineMs));
+    }
+    for (const auto& vector : vectors) {
+        uint32_t size = static_cast<uint32_t>(vector.size());
+        put(&size, sizeof(size));
+        put(vector.data(), vector.size() * sizeof(int16_t));
+    }
+    return request;
+}
+// Функция для прохождения аутентификации со стороны клиента
+string loginOverSocket(Server& server, int socket, const string& login, const string& password) {
+    char salt[16];
+    char reply[4] = {0};
+    if (!sendAll(socket, login.data(), login.size()) || !recvAll(socket, salt, sizeof(salt))) {
+        return "";
+    }
+    string hash = server.testSha224Hash(string(salt, sizeof(salt)) + password);
+    if (!sendAll(socket, hash.data(), hash.size()) || recv(socket, reply, 3, 0) <= 0) {
+        return "";
+    }
+    return reply;
+}
+// Функция для создания слушающего сокета на свободном порту loopback
+int listenLoopback(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), length) < 0 || listen(fd, 16) < 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+        return -1;
+    }
+    port = ntohs(address.sin_port);
+    return fd;
+}
+// Функция для подключения к loopback
+int connectLoopback(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        return -1;
+    }
+    return fd;
+}
 // ==================== ТЕСТЫ ВЫЧИСЛЕНИЙ (СУММА КВАДРАТОВ) ====================
 SUITE(CalculationTest)
 {
@@ -278,6 +391,1320 @@ SUITE(AuthIntegrationTest)
         CHECK(validHex);
     }
 }
+// ==================== ТЕСТЫ АКТИВАЦИИ ЧЕРЕЗ СОКЕТ ====================
+SUITE(SocketActivationTest)
+{
+    TEST(SocketActivationForThisProcess) {
+        setenv("LISTEN_PID", to_string(getpid()).c_str(), 1);
+        setenv("LISTEN_FDS", "1", 1);
+        CHECK_EQUAL(3, Server::socketActivationFd());
+        // Переменные удаляются после чтения
+        CHECK(getenv("LISTEN_PID") == nullptr);
+        CHECK(getenv("LISTEN_FDS") == nullptr);
+    }
+    
+    TEST(SocketActivationForOtherProcess) {
+        setenv("LISTEN_PID", to_string(getpid() + 1).c_str(), 1);
+        setenv("LISTEN_FDS", "1", 1);
+        CHECK_EQUAL(-1, Server::socketActivationFd());
+    }
+    
+    TEST(SocketActivationWithoutEnvironment) {
+        unsetenv("LISTEN_PID");
+        unsetenv("LISTEN_FDS");
+        CHECK_EQUAL(-1, Server::socketActivationFd());
+    }
+}
+// ==================== ТЕСТЫ МАРШРУТИЗАЦИИ ПРОКСИ ====================
+SUITE(ProxyRoutingTest)
+{
+    TEST(HashRingIsStable) {
+        HashRing ring;
+        ring.addBackend(0, "127.0.0.1:33401");
+        ring.addBackend(1, "127.0.0.1:33402");
+        auto any = [](size_t) { return true; };
+        CHECK_EQUAL(ring.lookup("alice", any), ring.lookup("alice", any));
+        CHECK_EQUAL(256, ring.size());
+    }
+    
+    TEST(HashRingMovesFewKeysOnGrowth) {
+        HashRing small;
+        HashRing large;
+        for (size_t i = 0; i < 4; ++i) {
+            small.addBackend(i, "10.0.0." + to_string(i) + ":33333");
+            large.addBackend(i, "10.0.0." + to_string(i) + ":33333");
+        }
+        large.addBackend(4, "10.0.0.4:33333");
+        
+        auto any = [](size_t) { return true; };
+        int moved = 0;
+        for (int i = 0; i < 1000; ++i) {
+            string login = "user" + to_string(i);
+            long before = small.lookup(login, any);
+            long after = large.lookup(login, any);
+            if (before != after) {
+                // Переезжать можно только на новый сервер
+                CHECK_EQUAL(4, after);
+                ++moved;
+            }
+        }
+        // Ожидается около 1/5 логинов
+        CHECK(moved > 100 && moved < 320);
+    }
+    
+    TEST(HashRingSkipsUnusableBackends) {
+        HashRing ring;
+        ring.addBackend(0, "127.0.0.1:33401");
+        ring.addBackend(1, "127.0.0.1:33402");
+        CHECK_EQUAL(1, ring.lookup("bob", [](size_t b) { return b == 1; }));
+        CHECK_EQUAL(-1, ring.lookup("bob", [](size_t) { return false; }));
+    }
+    
+    TEST(ProxySkipsDownBackend) {
+        ScaleProxy proxy(33400, {{"127.0.0.1", 33401}, {"127.0.0.1", 33402}}, "/log/scale-proxy.log");
+        long first = proxy.selectBackend("user");
+        proxy.backend(static_cast<size_t>(first)).healthy = false;
+        CHECK_EQUAL(1 - first, proxy.selectBackend("user"));
+        proxy.backend(static_cast<size_t>(1 - first)).healthy = false;
+        CHECK_EQUAL(-1, proxy.selectBackend("user"));
+    }
+    
+    TEST(ProxyBoundsBackendLoad) {
+        ScaleProxy proxy(33400, {{"127.0.0.1", 33401}, {"127.0.0.1", 33402}}, "/log/scale-proxy.log");
+        long first = proxy.selectBackend("user");
+        proxy.backend(static_cast<size_t>(first)).activeConnections = 10;
+        // Перегруженный сервер пропускается, пока есть свободный
+        CHECK_EQUAL(1 - first, proxy.selectBackend("user"));
+    }
+    
+    TEST(ProxyProbesOnlyIdleOrDownBackends) {
+        ScaleProxy proxy(33400, {{"127.0.0.1", 33401}}, "/log/scale-proxy.log");
+        proxy.setHealthInterval(2000);
+        Backend& target = proxy.backend(0);
+        CHECK(proxy.probeDue(target, 100000));
+        // Недавнее подключение клиента подтверждает живость
+        target.lastConnectedMs = 99000;
+        CHECK(!proxy.probeDue(target, 100000));
+        CHECK(proxy.probeDue(target, 101000));
+        target.healthy = false;
+        CHECK(proxy.probeDue(target, 100000));
+    }
+}
+// ==================== ТЕСТЫ ЖУРНАЛА РЕЗУЛЬТАТОВ ====================
+SUITE(ResultJournalTest)
+{
+    TEST(JournalRecordsAreDurableAndGrouped) {
+        string filename = "temp_test_journal_" + to_string(time(nullptr)) + ".bin";
+        {
+            ResultJournal journal(filename, 500, 64);
+            CHECK(journal.open());
+            
+            vector<thread> sessions;
+            for (int t = 0; t < 4; ++t) {
+                sessions.emplace_back([&journal, t] {
+                    for (int i = 0; i < 25; ++i) {
+                        uint64_t sequence = journal.append(ResultRecord::make("user" + to_string(t), 4, 30));
+                        CHECK(journal.waitDurable(sequence));
+                    }
+                });
+            }
+            for (auto& session : sessions) {
+                session.join();
+            }
+            CHECK_EQUAL(100u, journal.getDurableCount());
+            // Группировка: fdatasync вызывается реже, чем раз на запись
+            CHECK(journal.getCommitCount() < 100u);
+        }
+        
+        ifstream file(filename, ios::binary);
+        vector<ResultRecord> records(101);
+        file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(ResultRecord));
+        CHECK_EQUAL(100 * sizeof(ResultRecord), static_cast<size_t>(file.gcount()));
+        CHECK_EQUAL(string("user"), string(records[0].login).substr(0, 4));
+        CHECK_EQUAL(4u, records[0].vectorLength);
+        CHECK_EQUAL(30, records[0].result);
+        deleteTempFile(filename);
+    }
+    
+    TEST(JournalFlushesPendingRecordsOnClose) {
+        string filename = "temp_test_journal_close_" + to_string(time(nullptr)) + ".bin";
+        {
+            ResultJournal journal(filename, 1000000, 1024);
+            CHECK(journal.open());
+            journal.append(ResultRecord::make("alice", 2, 25));
+        }
+        ifstream file(filename, ios::binary | ios::ate);
+        CHECK_EQUAL(static_cast<long>(sizeof(ResultRecord)), static_cast<long>(file.tellg()));
+        deleteTempFile(filename);
+    }
+    
+    TEST(JournalRecordTruncatesLongLogin) {
+        ResultRecord record = ResultRecord::make(string(40, 'x'), 1, 1);
+        CHECK_EQUAL(31u, strlen(record.login));
+    }
+}
+// ==================== ТЕСТЫ ПУЛОВ СЕССИЙ ====================
+SUITE(SessionPoolTest)
+{
+    TEST(SessionIsCompact) {
+        // Простаивающее подключение не должно занимать больше двух кэш-линий
+        CHECK(sizeof(Session) <= 128);
+    }
+    
+    TEST(SlabPoolReusesSlots) {
+        SlabPool<Session, 4> pool;
+        Session* first = pool.create();
+        pool.destroy(first);
+        Session* second = pool.create();
+        CHECK(first == second);
+        CHECK_EQUAL(1u, pool.size());
+        CHECK_EQUAL(4u, pool.capacity());
+        pool.destroy(second);
+    }
+    
+    TEST(SlabPoolGrowsBySlab) {
+        SlabPool<Session, 4> pool;
+        vector<Session*> created;
+        for (int i = 0; i < 5; ++i) {
+            created.push_back(pool.create());
+        }
+        CHECK_EQUAL(5u, pool.size());
+        CHECK_EQUAL(8u, pool.capacity());
+        for (Session* session : created) {
+            pool.destroy(session);
+        }
+        CHECK_EQUAL(0u, pool.size());
+    }
+    
+    TEST(BufferPoolReturnsBuffers) {
+        BufferPool pool;
+        uint8_t* buffer = pool.acquire();
+        CHECK_EQUAL(1u, pool.inUse());
+        pool.release(buffer);
+        CHECK_EQUAL(0u, pool.inUse());
+        CHECK(buffer == pool.acquire());
+        CHECK_EQUAL(1u, pool.allocated());
+    }
+}
+// ==================== ТЕСТЫ СЧЕТЧИКОВ ====================
+SUITE(MetricsTest)
+{
+    TEST(FormatListsCancellations) {
+        ServerMetrics metrics;
+        metrics.batchesCancelledDeadline++;
+        metrics.vectorsCancelled += 7;
+        string text = metrics.format();
+        CHECK(text.find("scale_batches_cancelled_total{reason=\"deadline\"} 1\n") != string::npos);
+        CHECK(text.find("scale_batches_cancelled_total{reason=\"disconnect\"} 0\n") != string::npos);
+        CHECK(text.find("scale_vectors_cancelled_total 7\n") != string::npos);
+    }
+    
+    TEST(WriteToReplacesFile) {
+        string filename = "temp_test_metrics_" + to_string(time(nullptr)) + ".prom";
+        ServerMetrics metrics;
+        metrics.vectorsProcessed += 3;
+        CHECK(metrics.writeTo(filename));
+        ifstream file(filename);
+        stringstream content;
+        content << file.rdbuf();
+        CHECK_EQUAL(metrics.format(), content.str());
+        deleteTempFile(filename);
+    }
+    
+    TEST(WriteToFailsForMissingDirectory) {
+        ServerMetrics metrics;
+        CHECK(!metrics.writeTo("/nonexistent_dir/metrics.prom"));
+    }
+}
+// ==================== ТЕСТЫ TLS ====================
+SUITE(TlsTransportTest)
+{
+    TEST(OpenFailsForMissingCertificate) {
+        TlsContext context("/nonexistent_cert.pem", "/nonexistent_key.pem");
+        CHECK(!context.open());
+    }
+    
+    TEST(HandshakeAndPlaintextRoundTrip) {
+        string cert = "temp_test_cert_" + to_string(time(nullptr)) + ".pem";
+        string key = "temp_test_key_" + to_string(time(nullptr)) + ".pem";
+        string command = "openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes -days 1 "
+                         "-subj /CN=localhost -keyout " + key + " -out " + cert + " >/dev/null 2>&1";
+        CHECK_EQUAL(0, system(command.c_str()));
+        
+        TlsContext context(cert, key, false);
+        CHECK(context.open());
+        
+        int sockets[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+        thread client([&sockets] {
+            SSL_CTX* clientContext = SSL_CTX_new(TLS_client_method());
+            SSL* ssl = SSL_new(clientContext);
+            SSL_set_fd(ssl, sockets[1]);
+            if (SSL_connect(ssl) == 1) {
+                char buffer[5] = {0};
+                SSL_write(ssl, "ping", 4);
+                SSL_read(ssl, buffer, 4);
+                SSL_write(ssl, buffer, 4);
+            }
+            SSL_free(ssl);
+            SSL_CTX_free(clientContext);
+        });
+        
+        TlsSession session;
+        CHECK(context.accept(sockets[0], session));
+        CHECK(!session.isKernelOffloaded());
+        char buffer[5] = {0};
+        CHECK_EQUAL(4, session.recv(sockets[0], buffer, 4, 0));
+        CHECK_EQUAL(string("ping"), string(buffer));
+        CHECK_EQUAL(4, session.send(sockets[0], "pong", 4, 0));
+        CHECK_EQUAL(4, session.recv(sockets[0], buffer, 4, 0));
+        CHECK_EQUAL(string("pong"), string(buffer));
+        
+        client.join();
+        close(sockets[0]);
+        close(sockets[1]);
+        deleteTempFile(cert);
+        deleteTempFile(key);
+    }
+}
+// ==================== ТЕСТЫ БАЛАНСИРОВКИ ЦИКЛОВ ====================
+SUITE(WorkerRebalanceTest)
+{
+    TEST(HandoffQueueIsFifoAndBounded) {
+        HandoffQueue<int, 4> queue;
+        for (int i = 0; i < 4; ++i) {
+            CHECK(queue.push(i));
+        }
+        CHECK(!queue.push(4));
+        int value = -1;
+        CHECK(queue.pop(value));
+        CHECK_EQUAL(0, value);
+        CHECK(queue.push(4));
+        for (int expected = 1; expected <= 4; ++expected) {
+            CHECK(queue.pop(value));
+            CHECK_EQUAL(expected, value);
+        }
+        CHECK(!queue.pop(value));
+    }
+    
+    TEST(HandoffQueueAcceptsConcurrentProducers) {
+        HandoffQueue<int, 1024> queue;
+        vector<thread> producers;
+        for (int t = 0; t < 4; ++t) {
+            producers.emplace_back([&queue, t] {
+                for (int i = 0; i < 200; ++i) {
+                    while (!queue.push(t * 1000 + i)) {
+                    }
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        vector<int> last(4, -1);
+        int value;
+        int received = 0;
+        while (queue.pop(value)) {
+            // Порядок элементов одного писателя сохраняется
+            CHECK(value % 1000 > last[value / 1000]);
+            last[value / 1000] = value % 1000;
+            ++received;
+        }
+        CHECK_EQUAL(800, received);
+    }
+    
+    TEST(PlanMovesFromHottestToColdest) {
+        MigrationPlan plan = WorkerPool::plan({{0.9, 4.0, 7}, {0.1, 1.0, 3}, {0.0, 0.0, 3}, {0.3, 1.0, 3}});
+        CHECK_EQUAL(0u, plan.from);
+        CHECK_EQUAL(2u, plan.to);
+        CHECK_EQUAL(2u, plan.count);
+    }
+    
+    TEST(PlanKeepsBalancedWorkers) {
+        MigrationPlan plan = WorkerPool::plan({{0.30, 2.0, 5}, {0.25, 2.0, 5}});
+        CHECK_EQUAL(0u, plan.count);
+    }
+    
+    TEST(PlanNeverEmptiesSingleSessionWorker) {
+        MigrationPlan plan = WorkerPool::plan({{0.9, 1.0, 1}, {0.0, 0.0, 0}});
+        CHECK_EQUAL(0u, plan.count);
+    }
+    
+    TEST(IdleSessionMovesOnRequest) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop hot(server, listener);
+        EventLoop cold(server, -1);
+        thread hotRunner([&hot] { hot.run(); });
+        thread coldRunner([&cold] { cold.run(); });
+        
+        int client = connectLoopback(port);
+        CHECK_EQUAL(string("OK"), loginOverSocket(server, client, "user", "P@ssW0rd"));
+        // Клиент молчит: событий по сокету нет, перенос делает сам запрос
+        hot.requestMigration(&cold, 1);
+        for (int i = 0; i < 200 && cold.getLoad().sessions.load() == 0; ++i) {
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        CHECK_EQUAL(1u, cold.getLoad().sessions.load());
+        CHECK_EQUAL(1u, server.getMetrics().sessionsMigrated.load());
+        
+        vector<uint8_t> request = encodeBatch({{3, 4}});
+        CHECK(sendAll(client, request.data(), request.size()));
+        int16_t result = 0;
+        CHECK(recvAll(client, &result, sizeof(result)));
+        CHECK_EQUAL(25, result);
+        close(client);
+        
+        hot.stop();
+        cold.stop();
+        hotRunner.join();
+        coldRunner.join();
+        close(listener);
+        deleteTempFile(db);
+    }
+    
+    TEST(SessionMidVectorStaysUntilBatchEnds) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop hot(server, listener);
+        EventLoop cold(server, -1);
+        thread hotRunner([&hot] { hot.run(); });
+        thread coldRunner([&cold] { cold.run(); });
+        
+        int client = connectLoopback(port);
+        CHECK_EQUAL(string("OK"), loginOverSocket(server, client, "user", "P@ssW0rd"));
+        // Первая половина вектора: сумма квадратов уже накоплена в цикле
+        vector<uint8_t> request = encodeBatch({{3, 4}});
+        size_t half = request.size() - sizeof(int16_t);
+        CHECK(sendAll(client, request.data(), half));
+        this_thread::sleep_for(chrono::milliseconds(40));
+        hot.requestMigration(&cold, 1);
+        CHECK(sendAll(client, request.data() + half, request.size() - half));
+        int16_t result = 0;
+        CHECK(recvAll(client, &result, sizeof(result)));
+        CHECK_EQUAL(25, result);
+        CHECK_EQUAL(0u, server.getMetrics().sessionsMigrated.load());
+        close(client);
+        
+        hot.stop();
+        cold.stop();
+        hotRunner.join();
+        coldRunner.join();
+        close(listener);
+        deleteTempFile(db);
+    }
+}
+// ==================== ТЕСТЫ ПОДБОРА БУФЕРОВ СОКЕТА ====================
+SUITE(SocketTuningTest)
+{
+    TEST(SmallBatchKeepsReceiveAutotuning) {
+        SocketSizing sizing = planSocketBuffers(4, 100);
+        CHECK_EQUAL(0, sizing.receiveBuffer);
+        CHECK_EQUAL(static_cast<int>(kMinSendBuffer), sizing.sendBuffer);
+    }
+    
+    TEST(LargeBatchGetsWholeRequestWindow) {
+        SocketSizing sizing = planSocketBuffers(4, 65536);
+        CHECK_EQUAL(4 * (4 + 65536 * 2), sizing.receiveBuffer);
+        
+        sizing = planSocketBuffers(1000, 65536);
+        CHECK_EQUAL(static_cast<int>(kMaxReceiveBuffer), sizing.receiveBuffer);
+    }
+    
+    TEST(SendBufferFollowsResultVolume) {
+        CHECK_EQUAL(20000, planSocketBuffers(10000, 1).sendBuffer);
+        CHECK_EQUAL(static_cast<int>(kMaxSendBuffer), planSocketBuffers(1000000, 1).sendBuffer);
+    }
+}
+// ==================== ТЕСТЫ СТОРОЖА ЗАВИСАНИЙ ====================
+SUITE(WatchdogTest)
+{
+    TEST(DetectsStallWithStageAndConnection) {
+        ServerMetrics metrics;
+        vector<string> messages;
+        Watchdog watchdog(metrics, 20, [&messages](const string& message) { messages.push_back(message); }, -1);
+        Heartbeat* heartbeat = watchdog.attach("main");
+        
+        heartbeat->beat("compute", 7);
+        watchdog.check(Watchdog::nowNs());
+        CHECK_EQUAL(0u, metrics.stalls.load());
+        
+        this_thread::sleep_for(chrono::milliseconds(40));
+        watchdog.check(Watchdog::nowNs());
+        watchdog.check(Watchdog::nowNs());
+        CHECK_EQUAL(1u, metrics.stalls.load());
+        CHECK_EQUAL(1u, messages.size());
+        CHECK(messages[0].find("stage compute, connection 7") != string::npos);
+    }
+    
+    TEST(StallEndsOnNextBeat) {
+        ServerMetrics metrics;
+        Watchdog watchdog(metrics, 20, [](const string&) {}, -1);
+        Heartbeat* heartbeat = watchdog.attach("worker-0");
+        
+        heartbeat->beat("read-data", 3);
+        this_thread::sleep_for(chrono::milliseconds(40));
+        watchdog.check(Watchdog::nowNs());
+        heartbeat->idle();
+        watchdog.check(Watchdog::nowNs());
+        
+        CHECK_EQUAL(1u, metrics.stallDuration.total.load());
+        CHECK(metrics.stallDuration.sumUs.load() >= 40000u);
+        // Ожидание событий зависанием не считается
+        this_thread::sleep_for(chrono::milliseconds(40));
+        watchdog.check(Watchdog::nowNs());
+        CHECK_EQUAL(1u, metrics.stalls.load());
+    }
+    
+    TEST(HistogramBucketsAreCumulative) {
+        LatencyHistogram histogram;
+        histogram.observe(50);
+        histogram.observe(700);
+        histogram.observe(20000000);
+        string text = histogram.format("lag_ms");
+        CHECK(text.find("lag_ms_bucket{le=\"0.1\"} 1\n") != string::npos);
+        CHECK(text.find("lag_ms_bucket{le=\"1\"} 2\n") != string::npos);
+        CHECK(text.find("lag_ms_bucket{le=\"+Inf\"} 3\n") != string::npos);
+        CHECK(text.find("lag_ms_count 3\n") != string::npos);
+    }
+}
+// ==================== ТЕСТЫ БОЛЬШИХ СТРАНИЦ ====================
+SUITE(HugePagesTest)
+{
+    TEST(TableLivesInHugePageHeapWhenAvailable) {
+        bool reserved = reserveHugePageHeap(kHugePageSize) || hugePageHeapUsed() > 0;
+        unordered_map<string, string, hash<string>, equal_to<string>,
+                      HugePageAllocator<pair<const string, string>>> table;
+        table["alice"] = "password456";
+        
+        CHECK_EQUAL(reserved, hugePageOwns(&*table.find("alice")));
+        CHECK_EQUAL(string("password456"), table["alice"]);
+    }
+    
+    TEST(ExhaustedHeapFallsBackToRegularMemory) {
+        CHECK(hugePageAllocate(2 * kHugePageSize, 8) == nullptr);
+        
+        vector<int, HugePageAllocator<int>> values(kHugePageSize, 1);
+        CHECK(!hugePageOwns(values.data()));
+        CHECK_EQUAL(1, values.back());
+    }
+}
+// ==================== ТЕСТЫ АУТЕНТИФИКАЦИИ HMAC ====================
+SUITE(HmacAuthTest)
+{
+    TEST(MatchesRfc4231Vector) {
+        HmacKey key;
+        CHECK(key.init("Jefe"));
+        CHECK_EQUAL(string("A30E01098BC6DBBF45690F3A7E9E6D0F8BBEA2A39E6148008FD05E44"),
+                    key.sign("what do ya want for nothing?"));
+        CHECK(key.verify("what do ya want for nothing?", "a30e01098bc6dbbf45690f3a7e9e6d0f8bbea2a39e6148008fd05e44"));
+        CHECK(!key.verify("what do ya want for nothing!", "a30e01098bc6dbbf45690f3a7e9e6d0f8bbea2a39e6148008fd05e44"));
+    }
+    
+    TEST(PrefixSelectsHmacMode) {
+        string login = "HMAC:alice";
+        CHECK(takeHmacPrefix(login));
+        CHECK_EQUAL(string("alice"), login);
+        CHECK(!takeHmacPrefix(login));
+        CHECK_EQUAL(string("alice"), login);
+    }
+    
+    TEST(DerivedKeyEntryAuthenticatesOnlyWithHmac) {
+        string entry = derivedKeyEntry("alice", "password456");
+        string filename = createTempUserDb({{"user", "P@ssW0rd"}, {"alice", entry.substr(entry.find(':') + 1)}});
+        Server server(33333, filename, "/log/scale.log");
+        server.testLoadUserDatabase();
+        
+        string salt = "0123456789ABCDEF";
+        HmacKey aliceKey;
+        aliceKey.init(deriveHmacKey("alice", "password456"));
+        CHECK(server.testVerifyHmac("alice", salt, aliceKey.sign(salt)));
+        CHECK(!server.testVerifyHmac("alice", "FEDCBA9876543210", aliceKey.sign(salt)));
+        CHECK(!server.testVerifyHash("alice", salt, server.testSha224Hash(salt + "password456")));
+        
+        // Пользователь с паролем в базе может выбрать любой режим; ключ выводится при первом входе
+        CHECK_EQUAL(1u, server.getHmacKeysCount());
+        HmacKey userKey;
+        userKey.init(deriveHmacKey("user", "P@ssW0rd"));
+        CHECK(server.testVerifyHmac("user", salt, userKey.sign(salt)));
+        CHECK_EQUAL(2u, server.getHmacKeysCount());
+        CHECK(server.testVerifyHmac("user", "FEDCBA9876543210", userKey.sign("FEDCBA9876543210")));
+        CHECK_EQUAL(2u, server.getHmacKeysCount());
+        CHECK(!server.testVerifyHmac("nobody", salt, userKey.sign(salt)));
+        CHECK(server.testVerifyHash("user", salt, server.testSha224Hash(salt + "P@ssW0rd")));
+        
+        remove(filename.c_str());
+    }
+    
+    TEST(EventLoopDerivesPasswordKeyOffLoop) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop loop(server, listener);
+        thread runner([&loop] { loop.run(); });
+        
+        HmacKey key;
+        key.init(deriveHmacKey("user", "P@ssW0rd"));
+        for (const char* answer : {"right", "wrong"}) {
+            int client = connectLoopback(port);
+            char salt[16];
+            char reply[4] = {0};
+            CHECK(sendAll(client, "HMAC:user", 9));
+            CHECK(recvAll(client, salt, sizeof(salt)));
+            // Ответ уходит сразу: первый вход застает ключ еще не выведенным
+            string mac = key.sign(string(answer) == "right" ? string(salt, sizeof(salt)) : "0123456789ABCDEF");
+            CHECK(sendAll(client, mac.data(), mac.size()));
+            CHECK(recv(client, reply, 3, 0) > 0);
+            CHECK_EQUAL(string(answer) == "right" ? string("OK") : string("ERR"), string(reply));
+            close(client);
+        }
+        CHECK_EQUAL(1u, server.getHmacKeysCount());
+        
+        loop.stop();
+        runner.join();
+        close(listener);
+        deleteTempFile(db);
+    }
+}
+// ==================== ТЕСТЫ КОЛЬЦА РЕЗУЛЬТАТОВ ====================
+SUITE(ResultTapTest)
+{
+    string tapName(const char* suffix) {
+        return "/scale-test-tap-" + to_string(getpid()) + "-" + suffix;
+    }
+    
+    TEST(ReaderFollowsPublishedRecords) {
+        ResultTap tap(tapName("follow"), 16);
+        CHECK(tap.open());
+        ResultTapReader reader(tapName("follow"));
+        CHECK(reader.open());
+        
+        ResultRecord record;
+        CHECK(reader.next(record) == TapRead::Empty);
+        tap.publish(ResultRecord::make("alice", 3, 14));
+        tap.publish(ResultRecord::make("bob", 1, 4));
+        
+        CHECK(reader.next(record) == TapRead::Record);
+        CHECK_EQUAL(string("alice"), string(record.login));
+        CHECK_EQUAL(3u, record.vectorLength);
+        CHECK_EQUAL(14, record.result);
+        CHECK(reader.next(record) == TapRead::Record);
+        CHECK_EQUAL(string("bob"), string(record.login));
+        CHECK(reader.next(record) == TapRead::Empty);
+        CHECK_EQUAL(0u, reader.getMissed());
+    }
+    
+    TEST(RingIsNotWorldReadable) {
+        ResultTap tap(tapName("mode"), 16);
+        CHECK(tap.open());
+        struct stat info;
+        CHECK_EQUAL(0, stat(("/dev/shm" + tapName("mode")).c_str(), &info));
+        CHECK_EQUAL(0u, static_cast<unsigned>(info.st_mode & 0007));
+    }
+    
+    TEST(ExistingRingIsReplacedOnlyOnRequest) {
+        ResultTap running(tapName("taken"), 8);
+        CHECK(running.open());
+        running.publish(ResultRecord::make("user", 1, 1));
+        
+        ResultTap second(tapName("taken"), 8);
+        CHECK(!second.open());
+        CHECK_EQUAL(EEXIST, errno);
+        ResultTapReader reader(tapName("taken"));
+        CHECK(reader.open(true));
+        ResultRecord record;
+        CHECK(reader.next(record) == TapRead::Record);
+        
+        CHECK(second.open(true));
+        ResultTapReader fresh(tapName("taken"));
+        CHECK(fresh.open(true));
+        CHECK(fresh.next(record) == TapRead::Empty);
+    }
+    
+    TEST(SlowReaderIsLappedWithoutBlockingWriter) {
+        ResultTap tap(tapName("lap"), 8);
+        CHECK(tap.open());
+        ResultTapReader reader(tapName("lap"));
+        CHECK(reader.open());
+        
+        for (int i = 0; i < 20; ++i) {
+            tap.publish(ResultRecord::make("user", static_cast<uint32_t>(i), 0));
+        }
+        ResultRecord record;
+        CHECK(reader.next(record) == TapRead::Lapped);
+        CHECK_EQUAL(12u, reader.getMissed());
+        for (uint32_t i = 12; i < 20; ++i) {
+            CHECK(reader.next(record) == TapRead::Record);
+            CHECK_EQUAL(i, record.vectorLength);
+        }
+        CHECK(reader.next(record) == TapRead::Empty);
+    }
+    
+    TEST(ReaderSeesClosedRing) {
+        ResultTapReader reader(tapName("closed"));
+        CHECK(!reader.open());
+        ResultRecord record;
+        {
+            ResultTap tap(tapName("closed"), 8);
+            CHECK(tap.open());
+            CHECK(reader.open());
+            tap.publish(ResultRecord::make("user", 1, 1));
+        }
+        CHECK(reader.next(record) == TapRead::Record);
+        CHECK(reader.next(record) == TapRead::Closed);
+    }
+}
+// ==================== ТЕСТЫ ОБЩИХ ПРОХОДОВ ====================
+SUITE(MicroBatchTest)
+{
+    TEST(LanesMatchPerVectorResults) {
+        Server server(33333, "test_auth_db.txt", "/log/scale.log");
+        vector<vector<int16_t>> vectors = {{3}, {1, 2}, {-4, 4, 0, 7}, {100, 100, 100, 100, 100, 100, 100, 100},
+                                           {32767}, {-32768, -32768, -32768, -32768, -32768, -32768, -32768, -32768}};
+        MicroBatch batch(8, kDefaultBatchWindowUs);
+        for (const auto& vector : vectors) {
+            CHECK(batch.fits(static_cast<uint32_t>(vector.size())));
+            batch.add(nullptr, reinterpret_cast<const uint8_t*>(vector.data()), static_cast<uint32_t>(vector.size()));
+        }
+        batch.compute();
+        CHECK_EQUAL(vectors.size(), batch.size());
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            CHECK_EQUAL(server.testCalculateSumOfSquares(vectors[i]), batch.result(i));
+            CHECK_EQUAL(vectors[i].size(), batch.length(i));
+        }
+    }
+    
+    TEST(OnlyTinyVectorsFitLanes) {
+        MicroBatch disabled(0, kDefaultBatchWindowUs);
+        CHECK(!disabled.fits(1));
+        MicroBatch batch(4, kDefaultBatchWindowUs);
+        CHECK(!batch.fits(0));
+        CHECK(batch.fits(kLaneElements));
+        CHECK(!batch.fits(kLaneElements + 1));
+    }
+    
+    TEST(ReportsFullBatchAndWindow) {
+        MicroBatch batch(2, 1000000);
+        int16_t value = 5;
+        CHECK(batch.empty());
+        CHECK(!batch.add(nullptr, reinterpret_cast<const uint8_t*>(&value), 1));
+        CHECK(batch.remainingNs(std::chrono::steady_clock::now()) > 0);
+        CHECK(batch.add(nullptr, reinterpret_cast<const uint8_t*>(&value), 1));
+        CHECK_EQUAL(0, batch.remainingNs(std::chrono::steady_clock::now() + std::chrono::seconds(2)));
+        batch.clear();
+        CHECK(batch.empty());
+    }
+}
+// ==================== ТЕСТЫ ЗАПРОСОВ ПО ДИАПАЗОНАМ ====================
+SUITE(RangeIndexTest)
+{
+    TEST(RangesMatchDirectSums) {
+        vector<int16_t> values(1000);
+        srand(42);
+        for (auto& value : values) {
+            value = static_cast<int16_t>(rand() % 201 - 100);
+        }
+        PrefixIndex index(values);
+        CHECK_EQUAL(values.size(), index.size());
+        for (int i = 0; i < 2000; ++i) {
+            size_t start = static_cast<size_t>(rand()) % (values.size() + 1);
+            size_t end = start + static_cast<size_t>(rand()) % (values.size() - start + 1);
+            uint64_t expected = 0;
+            for (size_t j = start; j < end; ++j) {
+                expected += static_cast<uint64_t>(values[j] * values[j]);
+            }
+            CHECK_EQUAL(expected, index.sumOfSquares(start, end));
+        }
+    }
+    
+    TEST(BlockSumHandlesExtremeValues) {
+        vector<int16_t> block(kIndexBlock, -32768);
+        CHECK_EQUAL(static_cast<uint64_t>(kIndexBlock) << 30, blockSumOfSquares(block.data()));
+        block.assign(kIndexBlock, 32767);
+        CHECK_EQUAL(static_cast<uint64_t>(kIndexBlock) * 32767 * 32767, blockSumOfSquares(block.data()));
+    }
+    
+    TEST(QuerySaturatesAndRejectsBadRanges) {
+        PrefixIndex index(vector<int16_t>{1, 2, 3, 200, 200});
+        CHECK_EQUAL(14, index.query(0, 3));
+        CHECK_EQUAL(0, index.query(2, 2));
+        CHECK_EQUAL(32767, index.query(0, 5));
+        CHECK_EQUAL(kInvalidRange, index.query(3, 2));
+        CHECK_EQUAL(kInvalidRange, index.query(0, 6));
+    }
+    
+    TEST(StoreKeepsVectorsPerLogin) {
+        VectorStore store;
+        CHECK_EQUAL(1u, store.store("alice", vector<int16_t>{3, 4}));
+        CHECK_EQUAL(2u, store.store("alice", vector<int16_t>{1}));
+        CHECK_EQUAL(1u, store.store("bob", vector<int16_t>{5}));
+        CHECK_EQUAL(4u, store.storedElements());
+        CHECK(store.find("alice", 1) != nullptr);
+        CHECK_EQUAL(25, store.find("alice", 1)->query(0, 2));
+        CHECK(store.find("alice", 3) == nullptr);
+        CHECK(store.find("alice", 0) == nullptr);
+        CHECK(store.find("carol", 1) == nullptr);
+    }
+    
+    TEST(QuotaLimitsEachLogin) {
+        VectorStore store(4, 6);
+        CHECK_EQUAL(1u, store.store("alice", vector<int16_t>(3, 1)));
+        // Квота alice исчерпана, но другие логины еще могут хранить векторы
+        CHECK(!store.admits("alice", 2));
+        CHECK_EQUAL(0u, store.store("alice", vector<int16_t>(2, 1)));
+        CHECK_EQUAL(2u, store.store("alice", vector<int16_t>(1, 1)));
+        CHECK_EQUAL(1u, store.store("bob", vector<int16_t>(2, 1)));
+        // Общий объем ограничивает сумму квот
+        CHECK(!store.admits("carol", 1));
+        CHECK_EQUAL(6u, store.storedElements());
+    }
+}
+// ==================== ТЕСТЫ ПРОТОКОЛА ХРАНИМЫХ ВЕКТОРОВ ====================
+SUITE(StoredVectorProtocolTest)
+{
+    // Один запрос хранимых векторов на новом подключении; возвращает ответ сервера
+    vector<uint8_t> exchange(Server& server, const vector<uint32_t>& header, const vector<int16_t>& data,
+                             size_t replySize) {
+        int pair[2];
+        vector<uint8_t> reply(replySize);
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            return {};
+        }
+        sendAll(pair[1], header.data(), header.size() * sizeof(uint32_t));
+        sendAll(pair[1], data.data(), data.size() * sizeof(int16_t));
+        server.testProcessVectors(pair[0], "alice");
+        close(pair[0]);
+        if (!recvAll(pair[1], reply.data(), reply.size())) {
+            reply.clear();
+        }
+        // Лишних байт после ответа нет
+        char extra;
+        if (recv(pair[1], &extra, 1, 0) != 0) {
+            reply.clear();
+        }
+        close(pair[1]);
+        return reply;
+    }
+    
+    TEST(StoreAndQueryRanges) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        vector<uint8_t> reply = exchange(server, {kStoreVectorFlag, 3}, {3, 4, 5}, sizeof(uint32_t));
+        CHECK_EQUAL(4u, reply.size());
+        uint32_t handle = 0;
+        memcpy(&handle, reply.data(), sizeof(handle));
+        CHECK_EQUAL(1u, handle);
+        
+        reply = exchange(server, {kRangeQueryFlag | 3, handle, 0, 2, 1, 3, 2, 5}, {}, 3 * sizeof(int16_t));
+        CHECK_EQUAL(6u, reply.size());
+        int16_t results[3];
+        memcpy(results, reply.data(), sizeof(results));
+        CHECK_EQUAL(25, results[0]);
+        CHECK_EQUAL(41, results[1]);
+        CHECK_EQUAL(kInvalidRange, results[2]);
+        CHECK_EQUAL(1u, server.getMetrics().vectorsStored.load());
+        CHECK_EQUAL(3u, server.getMetrics().rangesAnswered.load());
+    }
+    
+    TEST(UnknownHandleGetsInvalidRanges) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        vector<uint8_t> reply = exchange(server, {kRangeQueryFlag | 2, 7, 0, 1, 0, 0}, {}, 2 * sizeof(int16_t));
+        CHECK_EQUAL(4u, reply.size());
+        int16_t results[2];
+        memcpy(results, reply.data(), sizeof(results));
+        CHECK_EQUAL(kInvalidRange, results[0]);
+        CHECK_EQUAL(kInvalidRange, results[1]);
+    }
+    
+    TEST(VectorOverQuotaGetsZeroHandle) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        // Данные не передаются: сервер отказывает по размеру, не читая вектор
+        uint32_t size = static_cast<uint32_t>(kMaxStoredElementsPerLogin + 1);
+        vector<uint8_t> reply = exchange(server, {kStoreVectorFlag, size}, {}, sizeof(uint32_t));
+        CHECK_EQUAL(4u, reply.size());
+        uint32_t handle = 1;
+        memcpy(&handle, reply.data(), sizeof(handle));
+        CHECK_EQUAL(0u, handle);
+        CHECK_EQUAL(0u, server.getMetrics().vectorsStored.load());
+    }
+    
+    TEST(MixedFlagsAreRejected) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        CHECK_EQUAL(0u, exchange(server, {kRangeQueryFlag | kBatchDeadlineFlag | 1}, {}, 0).size());
+        CHECK_EQUAL(0u, exchange(server, {kRangeQueryFlag | kStoreVectorFlag | 1}, {}, 0).size());
+        CHECK_EQUAL(0u, server.getMetrics().rangesAnswered.load());
+    }
+    
+    TEST(EventLoopRejectsStoredVectorRequests) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop loop(server, listener);
+        thread runner([&loop] { loop.run(); });
+        
+        for (uint32_t flag : {kStoreVectorFlag, kRangeQueryFlag | 1}) {
+            int client = connectLoopback(port);
+            CHECK_EQUAL(string("OK"), loginOverSocket(server, client, "user", "P@ssW0rd"));
+            CHECK(sendAll(client, &flag, sizeof(flag)));
+            char extra;
+            CHECK_EQUAL(0, recv(client, &extra, 1, 0));
+            close(client);
+        }
+        
+        loop.stop();
+        runner.join();
+        CHECK_EQUAL(0u, server.getMetrics().vectorsStored.load());
+        close(listener);
+        deleteTempFile(db);
+    }
+}
+// ==================== ТЕСТЫ КОНВЕЙЕРА ПРИЕМА ====================
+SUITE(PipelineTest)
+{
+    TEST(ReadsAheadIntoSecondBuffer) {
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        ReceivePipeline pipeline(8);
+        pipeline.reset([&pair](void* buffer, size_t size, int flags) {
+            return recv(pair[0], buffer, size, flags);
+        }, true);
+        
+        const char payload[] = "0123456789abcdef";
+        CHECK_EQUAL(16, send(pair[1], payload, 16, 0));
+        const uint8_t* data;
+        CHECK_EQUAL(5u, pipeline.next(data, 5));
+        CHECK_EQUAL(0, memcmp(data, "01234", 5));
+        pipeline.drain();
+        CHECK_EQUAL(11u, pipeline.buffered());
+        
+        // Участок пересекает границу буферов: read() склеивает его сам
+        char joined[6];
+        CHECK(pipeline.read(joined, 6));
+        CHECK_EQUAL(0, memcmp(joined, "56789a", 6));
+        close(pair[1]);
+        char rest[5];
+        CHECK(pipeline.read(rest, 5));
+        CHECK_EQUAL(0, memcmp(rest, "bcdef", 5));
+        CHECK_EQUAL(0u, pipeline.next(data, 1));
+        close(pair[0]);
+    }
+    
+    TEST(SendQueueKeepsWhatSocketRefuses) {
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        int small = 4096;
+        setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+        SendQueue output([&pair](const void* buffer, size_t size, int flags) {
+            return send(pair[0], buffer, size, flags | MSG_NOSIGNAL);
+        }, true);
+        
+        vector<uint8_t> block(1024 * 1024, 7);
+        output.push(block.data(), block.size());
+        CHECK(output.flush(false));
+        CHECK(output.pending() > 0);
+        
+        std::thread reader([&pair, &block] {
+            vector<uint8_t> received(block.size());
+            size_t total = 0;
+            while (total < received.size()) {
+                ssize_t n = recv(pair[1], received.data() + total, received.size() - total, 0);
+                if (n <= 0) {
+                    break;
+                }
+                total += static_cast<size_t>(n);
+            }
+        });
+        CHECK(output.flush(true));
+        CHECK_EQUAL(0u, output.pending());
+        reader.join();
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(AccumulatesUnalignedElements) {
+        uint8_t bytes[7] = {0, 3, 0, 0xFC, 0xFF, 2, 0};
+        CHECK_EQUAL(29, accumulateSquares(bytes + 1, 3));
+    }
+    
+    TEST(SquareSumJoinsSplitElements) {
+        // Элементы 3, -4, 2 участками по 1, 2 и 3 байта
+        uint8_t bytes[6] = {3, 0, 0xFC, 0xFF, 2, 0};
+        SquareSum square;
+        CHECK_EQUAL(0u, square.add(bytes, 1));
+        CHECK_EQUAL(1u, square.add(bytes + 1, 2));
+        CHECK_EQUAL(2u, square.add(bytes + 3, 3));
+        CHECK_EQUAL(29, square.result());
+        CHECK(!square.hasOddByte);
+    }
+    
+    TEST(SquareSumSaturates) {
+        vector<int16_t> values(100000, 1000);
+        SquareSum square;
+        square.add(reinterpret_cast<const uint8_t*>(values.data()), values.size() * sizeof(int16_t));
+        square.add(reinterpret_cast<const uint8_t*>(values.data()), values.size() * sizeof(int16_t));
+        CHECK_EQUAL(32767, square.result());
+    }
+}
+// ==================== ТЕСТЫ СОБЫТИЙНОГО РЕЖИМА ====================
+SUITE(EventModeProtocolTest)
+{
+    TEST(EventLoopServesLoginAndBatch) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        CHECK(listener >= 0);
+        EventLoop loop(server, listener);
+        thread runner([&loop] { loop.run(); });
+        
+        int client = connectLoopback(port);
+        CHECK_EQUAL(string("OK"), loginOverSocket(server, client, "user", "P@ssW0rd"));
+        // Пакет уходит побайтно: каждое поле разорвано между событиями epoll
+        vector<uint8_t> request = encodeBatch({{3, 4}, {1000}, {}});
+        for (uint8_t byte : request) {
+            CHECK(sendAll(client, &byte, 1));
+        }
+        int16_t results[3] = {0, 0, 0};
+        CHECK(recvAll(client, results, sizeof(results)));
+        CHECK_EQUAL(25, results[0]);
+        CHECK_EQUAL(32767, results[1]);
+        CHECK_EQUAL(0, results[2]);
+        // После пакета сервер закрывает подключение
+        char extra;
+        CHECK_EQUAL(0, recv(client, &extra, 1, 0));
+        close(client);
+        
+        loop.stop();
+        runner.join();
+        CHECK_EQUAL(3u, server.getMetrics().vectorsProcessed.load());
+        close(listener);
+        deleteTempFile(db);
+    }
+    
+    TEST(EventLoopRejectsWrongHash) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop loop(server, listener);
+        thread runner([&loop] { loop.run(); });
+        
+        int client = connectLoopback(port);
+        CHECK_EQUAL(string("ERR"), loginOverSocket(server, client, "user", "wrong"));
+        close(client);
+        
+        loop.stop();
+        runner.join();
+        close(listener);
+        deleteTempFile(db);
+    }
+}
+// ==================== ТЕСТЫ СРОКА ПАКЕТА ====================
+SUITE(BatchDeadlineTest)
+{
+    TEST(BatchWithinDeadlineIsAnswered) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        vector<uint8_t> request = encodeBatch({{3, 4}, {1, 2}}, 5000);
+        CHECK(sendAll(pair[1], request.data(), request.size()));
+        
+        server.testProcessVectors(pair[0], "user");
+        int16_t results[2] = {0, 0};
+        CHECK(recvAll(pair[1], results, sizeof(results)));
+        CHECK_EQUAL(25, results[0]);
+        CHECK_EQUAL(5, results[1]);
+        CHECK_EQUAL(0u, server.getMetrics().batchesCancelledDeadline.load());
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(StalledBatchIsCancelledAtDeadline) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        // Заявлены три вектора, пришел один: остальных сервер ждет только до срока
+        vector<uint8_t> request = encodeBatch({{3, 4}}, 50, 3);
+        CHECK(sendAll(pair[1], request.data(), request.size()));
+        
+        auto started = chrono::steady_clock::now();
+        server.testProcessVectors(pair[0], "user");
+        auto waited = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+        CHECK(waited >= 50 && waited < 2000);
+        int16_t result = 0;
+        CHECK(recvAll(pair[1], &result, sizeof(result)));
+        CHECK_EQUAL(25, result);
+        CHECK_EQUAL(1u, server.getMetrics().batchesCancelledDeadline.load());
+        CHECK_EQUAL(2u, server.getMetrics().vectorsCancelled.load());
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(BatchIsCancelledWhenClientLeaves) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        vector<uint8_t> request = encodeBatch({{3, 4}}, 5000, 3);
+        CHECK(sendAll(pair[1], request.data(), request.size()));
+        shutdown(pair[1], SHUT_WR);
+        
+        // Уход клиента обнаруживается сразу, а не по сроку
+        auto started = chrono::steady_clock::now();
+        server.testProcessVectors(pair[0], "user");
+        auto waited = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+        CHECK(waited < 2000);
+        CHECK_EQUAL(1u, server.getMetrics().batchesCancelledDisconnect.load());
+        CHECK_EQUAL(2u, server.getMetrics().vectorsCancelled.load());
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(StrictJournalAnswersBeforeDeadlineWait) {
+        string filename = "temp_test_journal_" + to_string(time(nullptr)) + "_deadline.bin";
+        ResultJournal journal(filename);
+        CHECK(journal.open());
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        server.setJournal(&journal, true);
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        timeval timeout{2, 0};
+        setsockopt(pair[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        
+        // Клиент шлет следующий вектор, только получив результат предыдущего
+        vector<int16_t> results;
+        thread client([&] {
+            vector<uint8_t> request = encodeBatch({{3, 4}}, 5000, 2);
+            sendAll(pair[1], request.data(), request.size());
+            int16_t result = 0;
+            if (recvAll(pair[1], &result, sizeof(result))) {
+                results.push_back(result);
+                uint32_t size = 1;
+                int16_t value = 5;
+                sendAll(pair[1], &size, sizeof(size));
+                sendAll(pair[1], &value, sizeof(value));
+                if (recvAll(pair[1], &result, sizeof(result))) {
+                    results.push_back(result);
+                }
+            }
+        });
+        
+        auto started = chrono::steady_clock::now();
+        server.testProcessVectors(pair[0], "user");
+        auto waited = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+        client.join();
+        CHECK(waited < 2000);
+        CHECK_EQUAL(2u, results.size());
+        CHECK(results == vector<int16_t>({25, 25}));
+        CHECK_EQUAL(0u, server.getMetrics().batchesCancelledDeadline.load());
+        CHECK_EQUAL(2u, journal.getDurableCount());
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(EventLoopExpiresDeadline) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop loop(server, listener);
+        thread runner([&loop] { loop.run(); });
+        
+        int client = connectLoopback(port);
+        CHECK_EQUAL(string("OK"), loginOverSocket(server, client, "user", "P@ssW0rd"));
+        vector<uint8_t> request = encodeBatch({{3, 4}}, 50, 2);
+        CHECK(sendAll(client, request.data(), request.size()));
+        int16_t result = 0;
+        CHECK(recvAll(client, &result, sizeof(result)));
+        CHECK_EQUAL(25, result);
+        // По истечении срока цикл закрывает подключение
+        char extra;
+        CHECK_EQUAL(0, recv(client, &extra, 1, 0));
+        close(client);
+        
+        loop.stop();
+        runner.join();
+        CHECK_EQUAL(1u, server.getMetrics().batchesCancelledDeadline.load());
+        CHECK_EQUAL(1u, server.getMetrics().vectorsCancelled.load());
+        close(listener);
+        deleteTempFile(db);
+    }
+    
+    TEST(EventLoopCancelsOnDisconnect) {
+        string db = createTempUserDb({{"user", "P@ssW0rd"}});
+        Server server(33333, db, "/log/scale.log");
+        server.testLoadUserDatabase();
+        uint16_t port = 0;
+        int listener = listenLoopback(port);
+        EventLoop loop(server, listener);
+        thread runner([&loop] { loop.run(); });
+        
+        int client = connectLoopback(port);
+        CHECK_EQUAL(string("OK"), loginOverSocket(server, client, "user", "P@ssW0rd"));
+        vector<uint8_t> request = encodeBatch({{3, 4}}, 5000, 3);
+        CHECK(sendAll(client, request.data(), request.size()));
+        shutdown(client, SHUT_WR);
+        int16_t result = 0;
+        CHECK(recvAll(client, &result, sizeof(result)));
+        char extra;
+        CHECK_EQUAL(0, recv(client, &extra, 1, 0));
+        close(client);
+        
+        loop.stop();
+        runner.join();
+        CHECK_EQUAL(0u, server.getMetrics().batchesCancelledDeadline.load());
+        CHECK_EQUAL(1u, server.getMetrics().batchesCancelledDisconnect.load());
+        CHECK_EQUAL(2u, server.getMetrics().vectorsCancelled.load());
+        close(listener);
+        deleteTempFile(db);
+    }
+}
+// ==================== ТЕСТЫ ПОСЛЕДОВАТЕЛЬНОЙ ОБРАБОТКИ ПАКЕТА ====================
+SUITE(ProcessVectorsTest)
+{
+    // Пакет из count векторов по одному элементу i % 100
+    vector<vector<int16_t>> tinyVectors(size_t count) {
+        vector<vector<int16_t>> vectors(count);
+        for (size_t i = 0; i < count; ++i) {
+            vectors[i] = {static_cast<int16_t>(i % 100)};
+        }
+        return vectors;
+    }
+    
+    TEST(ElementsSplitAcrossReceives) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        vector<uint8_t> request = encodeBatch({{3, -4, 2}, {1000, 1}, {7}});
+        // Побайтно с паузами: каждый recv() получает не больше байта, элементы разорваны
+        thread writer([&] {
+            for (uint8_t byte : request) {
+                sendAll(pair[1], &byte, 1);
+                this_thread::sleep_for(chrono::microseconds(500));
+            }
+        });
+        
+        server.testProcessVectors(pair[0], "user");
+        writer.join();
+        int16_t results[3] = {0, 0, 0};
+        CHECK(recvAll(pair[1], results, sizeof(results)));
+        CHECK_EQUAL(29, results[0]);
+        CHECK_EQUAL(32767, results[1]);
+        CHECK_EQUAL(49, results[2]);
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(ResultsWaitForFullSendBuffer) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        int small = 4096;
+        setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+        const size_t count = 100000;
+        vector<uint8_t> request = encodeBatch(tinyVectors(count));
+        thread writer([&] { sendAll(pair[1], request.data(), request.size()); });
+        // Клиент читает с опозданием: результаты копятся в очереди, а отправка ждет сокет
+        vector<int16_t> results(count);
+        bool received = false;
+        thread reader([&] {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            received = recvAll(pair[1], results.data(), results.size() * sizeof(int16_t));
+        });
+        
+        server.testProcessVectors(pair[0], "user");
+        writer.join();
+        reader.join();
+        CHECK(received);
+        bool ordered = true;
+        for (size_t i = 0; i < count; ++i) {
+            ordered = ordered && results[i] == static_cast<int16_t>((i % 100) * (i % 100));
+        }
+        CHECK(ordered);
+        CHECK_EQUAL(count, server.getMetrics().vectorsProcessed.load());
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(PendingResultsAreSentBeforeBlockingReceive) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        int small = 4096;
+        setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+        timeval timeout{2, 0};
+        setsockopt(pair[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        
+        // Последний вектор клиент шлет, только получив все предыдущие результаты:
+        // их больше, чем помещается в сокет, и остаток ждет в очереди отправки
+        const size_t count = 3000;
+        bool answered = false;
+        thread client([&] {
+            vector<uint8_t> request = encodeBatch(tinyVectors(count), 0, count + 1);
+            sendAll(pair[1], request.data(), request.size());
+            vector<int16_t> results(count + 1);
+            if (recvAll(pair[1], results.data(), count * sizeof(int16_t))) {
+                uint32_t size = 1;
+                int16_t value = 2;
+                sendAll(pair[1], &size, sizeof(size));
+                sendAll(pair[1], &value, sizeof(value));
+                answered = recvAll(pair[1], &results[count], sizeof(int16_t)) && results[count] == 4;
+            }
+            // Без ответа прием сервера прервется закрытием
+            shutdown(pair[1], SHUT_RDWR);
+        });
+        
+        server.testProcessVectors(pair[0], "user");
+        client.join();
+        CHECK(answered);
+        CHECK_EQUAL(count + 1, server.getMetrics().vectorsProcessed.load());
+        close(pair[0]);
+        close(pair[1]);
+    }
+    
+    TEST(DeadlineExpiresWithRequestBuffered) {
+        Server server(33333, "/scale.conf", "/log/scale.log");
+        int pair[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+        int small = 4096;
+        setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+        const size_t count = 100000;
+        vector<uint8_t> request = encodeBatch(tinyVectors(count), 50);
+        thread writer([&] { sendAll(pair[1], request.data(), request.size()); });
+        // Пока клиент не читает, срок истекает: остаток пакета уже принят, но не нужен
+        vector<uint8_t> received;
+        thread reader([&] {
+            this_thread::sleep_for(chrono::milliseconds(200));
+            char buffer[65536];
+            ssize_t bytes;
+            while ((bytes = recv(pair[1], buffer, sizeof(buffer), 0)) > 0) {
+                received.insert(received.end(), buffer, buffer + bytes);
+            }
+        });
+        
+        server.testProcessVectors(pair[0], "user");
+        shutdown(pair[0], SHUT_RDWR);
+        writer.join();
+        reader.join();
+        CHECK_EQUAL(1u, server.getMetrics().batchesCancelledDeadline.load());
+        size_t answered = received.size() / sizeof(int16_t);
+        CHECK(answered > 0 && answered < count);
+        CHECK_EQUAL(count - server.getMetrics().vectorsProcessed.load(), server.getMetrics().vectorsCancelled.load());
+        close(pair[0]);
+        close(pair[1]);
+    }
+}
 // ==================== ГЛАВНАЯ ФУНКЦИЯ ТЕСТОВ ====================
 int main()
 {
@@ -293,6 +1720,7 @@ int main()
     system("rm -f temp_test_db_*.txt 2>/dev/null || true");
     system("rm -f empty_test_*.txt 2>/dev/null || true");
     system("rm -f invalid_test_*.txt 2>/dev/null || true");
+    system("rm -f temp_test_journal_*.bin 2>/dev/null || true");
     
     return result;
 }
@@ -7,6 +7,7 @@ echo "Дата: $(date '+%Y-%m-%d %H:%M:%S')"
 echo ""
 # Глобальные переменные
 SERVER="./server"
+PROXY="./scale-proxy"
 REPORT_FILE="final_test_report.md"
 TEST_CONFIG="final_test.conf"
 TEST_LOG="/tmp/scale_test.log"
@@ -248,6 +249,98 @@ test_05_nonexistent_db() {
         return 1
     fi
 }
+# Тест 6: Прокси распределяет клиентов между серверами
+test_06_proxy() {
+    echo "Проверка: Аутентификация и вычисление через scale-proxy"
+    
+    PROXY_PORT=33450
+    for port in $PROXY_PORT 33451 33452; do
+        cleanup_port $port
+    done
+    
+    echo "user:P@ssW0rd" > test_proxy.conf
+    "./$SERVER" -p 33451 -c "test_proxy.conf" -l "test_proxy1.log" > /dev/null &
+    local PID1=$!
+    "./$SERVER" -p 33452 -c "test_proxy.conf" -l "test_proxy2.log" > /dev/null &
+    local PID2=$!
+    "./$PROXY" -p $PROXY_PORT -b 127.0.0.1:33451 -b 127.0.0.1:33452 -l "test_proxy.log" > /dev/null &
+    local PID3=$!
+    sleep 2
+    
+    local result=""
+    if exec 3<>/dev/tcp/127.0.0.1/$PROXY_PORT; then
+        printf 'user' >&3
+        local salt
+        read -r -N 16 -t 3 salt <&3
+        local hash
+        hash=$(printf '%s%s' "$salt" 'P@ssW0rd' | openssl dgst -sha224 | awk '{print toupper($NF)}')
+        printf '%s' "$hash" >&3
+        local reply
+        read -r -N 2 -t 3 reply <&3
+        if [ "$reply" = "OK" ]; then
+            # Один вектор {3, 4}: ожидаем 3² + 4² = 25
+            printf '\x01\x00\x00\x00\x02\x00\x00\x00\x03\x00\x04\x00' >&3
+            result=$(timeout 3 head -c 2 <&3 | od -An -tu2 | tr -d ' ')
+        fi
+        exec 3<&-
+    fi
+    
+    kill $PID1 $PID2 $PID3 2>/dev/null
+    sleep 1
+    rm -f test_proxy.conf test_proxy*.log 2>/dev/null
+    for port in $PROXY_PORT 33451 33452; do
+        cleanup_port $port
+    done
+    
+    if [ "$result" = "25" ]; then
+        echo "   Клиент получил результат через прокси"
+        return 0
+    fi
+    echo "   Неверный результат через прокси: '$result'"
+    return 1
+}
+# Тест 7: Событийный режим обслуживает тот же протокол
+test_07_event_mode() {
+    echo "Проверка: Аутентификация и пакет векторов в событийном режиме (-e)"
+    
+    PORT=33453
+    cleanup_port $PORT
+    
+    echo "user:P@ssW0rd" > test_event.conf
+    "./$SERVER" -p $PORT -c "test_event.conf" -l "test_event.log" -e > /dev/null &
+    local PID=$!
+    sleep 2
+    
+    local result=""
+    if exec 3<>/dev/tcp/127.0.0.1/$PORT; then
+        printf 'user' >&3
+        local salt
+        read -r -N 16 -t 3 salt <&3
+        local hash
+        hash=$(printf '%s%s' "$salt" 'P@ssW0rd' | openssl dgst -sha224 | awk '{print toupper($NF)}')
+        printf '%s' "$hash" >&3
+        local reply
+        read -r -N 2 -t 3 reply <&3
+        if [ "$reply" = "OK" ]; then
+            # Векторы {3, 4} и {1, 2}: ожидаем 25 и 5
+            printf '\x02\x00\x00\x00\x02\x00\x00\x00\x03\x00\x04\x00\x02\x00\x00\x00\x01\x00\x02\x00' >&3
+            result=$(timeout 3 head -c 4 <&3 | od -An -tu2 | xargs)
+        fi
+        exec 3<&-
+    fi
+    
+    kill $PID 2>/dev/null
+    sleep 1
+    rm -f test_event.conf test_event.log 2>/dev/null
+    cleanup_port $PORT
+    
+    if [ "$result" = "25 5" ]; then
+        echo "   Клиент получил результаты в событийном режиме"
+        return 0
+    fi
+    echo "   Неверные результаты в событийном режиме: '$result'"
+    return 1
+}
 # Главная функция
 main() {
     # Проверяем наличие сервера
@@ -292,6 +385,12 @@ main() {
     run_test "05" "Несуществующий файл БД" test_05_nonexistent_db
     test_status[5]=$?
     
+    run_test "06" "Маршрутизация через scale-proxy" test_06_proxy
+    test_status[6]=$?
+    
+    run_test "07" "Событийный режим" test_07_event_mode
+    test_status[7]=$?
+    
     # Создаем таблицу тест-кейсов
     echo "" >> "$REPORT_FILE"
     echo "## Тест-кейсы функционального тестирования" >> "$REPORT_FILE"
@@ -300,7 +399,7 @@ main() {
     echo "|----------|----------|-----|----------|---------------------|----------------------|------|" >> "$REPORT_FILE"
     
     # Заполняем таблицу
-    for i in {1..5}; do
+    for i in {1..7}; do
         case $i in
             1)
                 name="Базовый запуск сервера"
@@ -327,6 +426,16 @@ main() {
                 desc="Обработка несуществующего файла базы данных"
                 expected="Сервер запускается (БД может быть пустой)"
                 ;;
+            6)
+                name="Маршрутизация через scale-proxy"
+                desc="Аутентификация и вычисление через прокси с двумя серверами"
+                expected="Клиент получает результат от сервера за прокси"
+                ;;
+            7)
+                name="Событийный режим"
+                desc="Аутентификация и пакет из двух векторов на сервере с -e"
+                expected="Клиент получает результаты 25 и 5"
+                ;;
         esac
         
         if [ ${test_status[$i]} -eq 0 ]; then
@@ -387,7 +496,7 @@ main() {
     rm -f test*.log test*.conf test*.db 2>/dev/null
     
     # Очищаем все тестовые порты
-    for port in 33444 33445 33447 33448; do
+    for port in 33444 33445 33447 33448 33450 33451 33452 33453; do
         cleanup_port $port
     done
     
@@ -0,0 +1,86 @@
+/**
+ * @file tls.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация шифрованного транспорта.
+ */
+
+#include "tls.h"
+#include <climits>
+#include <algorithm>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include <openssl/bio.h>
+
+TlsSession::~TlsSession() {
+    if (ssl) {
+        SSL_free(ssl);
+    }
+}
+
+ssize_t TlsSession::recv(int socket, void* buffer, size_t size, int flags) {
+    if (kernelRecv) {
+        return ::recv(socket, buffer, size, flags);
+    }
+    int bytesRead = SSL_read(ssl, buffer, static_cast<int>(std::min<size_t>(size, INT_MAX)));
+    if (bytesRead <= 0) {
+        return SSL_get_error(ssl, bytesRead) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+    }
+    return bytesRead;
+}
+
+ssize_t TlsSession::send(int socket, const void* buffer, size_t size, int flags) {
+    if (kernelSend) {
+        return ::send(socket, buffer, size, flags | MSG_NOSIGNAL);
+    }
+    int bytesSent = SSL_write(ssl, buffer, static_cast<int>(std::min<size_t>(size, INT_MAX)));
+    return bytesSent > 0 ? bytesSent : -1;
+}
+
+size_t TlsSession::pending() const {
+    return kernelRecv ? 0 : static_cast<size_t>(SSL_pending(ssl));
+}
+
+void TlsSession::shutdown() {
+    if (ssl) {
+        SSL_shutdown(ssl);
+    }
+}
+
+TlsContext::TlsContext(const std::string& certPath, const std::string& keyPath, bool kernelOffload)
+    : certPath(certPath), keyPath(keyPath), kernelOffload(kernelOffload) {}
+
+TlsContext::~TlsContext() {
+    if (context) {
+        SSL_CTX_free(context);
+    }
+}
+
+bool TlsContext::open() {
+    context = SSL_CTX_new(TLS_server_method());
+    if (!context) {
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    // Билеты сессий после рукопожатия не нужны: клиент отправляет один пакет
+    SSL_CTX_set_num_tickets(context, 0);
+    if (kernelOffload) {
+        SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+    }
+    return SSL_CTX_use_certificate_chain_file(context, certPath.c_str()) == 1 &&
+           SSL_CTX_use_PrivateKey_file(context, keyPath.c_str(), SSL_FILETYPE_PEM) == 1 &&
+           SSL_CTX_check_private_key(context) == 1;
+}
+
+bool TlsContext::accept(int socket, TlsSession& session) {
+    session.ssl = SSL_new(context);
+    if (!session.ssl || SSL_set_fd(session.ssl, socket) != 1 || SSL_accept(session.ssl) != 1) {
+        return false;
+    }
+
+    // Ядро берет на себя только направления, для которых OpenSSL передал ему
+    // ключи; прием — лишь если в буфере OpenSSL не осталось данных клиента
+    session.kernelSend = BIO_get_ktls_send(SSL_get_wbio(session.ssl)) > 0;
+    session.kernelRecv = BIO_get_ktls_recv(SSL_get_rbio(session.ssl)) > 0 && !SSL_has_pending(session.ssl);
+    return true;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file tls.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл шифрованного транспорта (TLS с передачей в ядро).
+ * @details Рукопожатие выполняет OpenSSL в пользовательском пространстве,
+ *          после чего симметричное шифрование передается ядру (kTLS,
+ *          TCP_ULP "tls"). Тогда сокет принимает и отдает открытый текст, и
+ *          циклы recv()/send() сервера работают без лишних копий. Если ядро не
+ *          поддерживает kTLS для выбранного шифра, данные шифрует OpenSSL
+ *          (SSL_read()/SSL_write()).
+ */
+
+#ifndef TLS_H
+#define TLS_H
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+/**
+ * @brief TLS-соединение одного клиента.
+ */
+class TlsSession {
+public:
+    TlsSession() = default;
+
+    /**
+     * @brief Деструктор: освобождает состояние OpenSSL (сокет не закрывается).
+     */
+    ~TlsSession();
+
+    TlsSession(const TlsSession&) = delete;
+    TlsSession& operator=(const TlsSession&) = delete;
+
+    /**
+     * @brief Принимает данные от клиента.
+     * @param socket Сокет клиента.
+     * @param buffer Буфер для открытого текста.
+     * @param size Размер буфера.
+     * @param flags Флаги recv() (учитываются только при kTLS).
+     * @return Количество байт, 0 при закрытии соединения, -1 при ошибке.
+     */
+    ssize_t recv(int socket, void* buffer, size_t size, int flags);
+
+    /**
+     * @brief Отправляет данные клиенту.
+     * @param socket Сокет клиента.
+     * @param buffer Открытый текст.
+     * @param size Количество байт.
+     * @param flags Флаги send() (учитываются только при kTLS).
+     * @return Количество отправленных байт или -1 при ошибке.
+     */
+    ssize_t send(int socket, const void* buffer, size_t size, int flags);
+
+    /**
+     * @brief Возвращает объем расшифрованных, но еще не прочитанных данных.
+     * @details Такие данные лежат в буфере OpenSSL, и poll() на сокете их не видит.
+     */
+    size_t pending() const;
+
+    /**
+     * @brief Отправляет close_notify клиенту.
+     */
+    void shutdown();
+
+    /**
+     * @brief Проверяет, что шифрование в обе стороны выполняет ядро.
+     */
+    bool isKernelOffloaded() const { return kernelSend && kernelRecv; }
+
+private:
+    friend class TlsContext;
+
+    SSL* ssl = nullptr;       ///< Состояние OpenSSL
+    bool kernelSend = false;  ///< Отправку шифрует ядро
+    bool kernelRecv = false;  ///< Прием расшифровывает ядро
+};
+
+/**
+ * @brief Серверный контекст TLS: сертификат, ключ и параметры рукопожатия.
+ */
+class TlsContext {
+public:
+    /**
+     * @brief Конструктор контекста.
+     * @param certPath Файл сертификата (PEM, допускается цепочка).
+     * @param keyPath Файл закрытого ключа (PEM).
+     * @param kernelOffload true — передавать шифрование ядру, если оно это умеет.
+     */
+    TlsContext(const std::string& certPath, const std::string& keyPath, bool kernelOffload = true);
+
+    /**
+     * @brief Деструктор: освобождает SSL_CTX.
+     */
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    /**
+     * @brief Загружает сертификат и ключ.
+     * @return false если файлы не загрузились или ключ не подходит к сертификату.
+     */
+    bool open();
+
+    /**
+     * @brief Выполняет рукопожатие на блокирующем сокете клиента.
+     * @param socket Принятый сокет.
+     * @param session Соединение, заполняемое при успехе.
+     * @return true если рукопожатие завершено.
+     */
+    bool accept(int socket, TlsSession& session);
+
+    /**
+     * @brief Возвращает true, если передача шифрования ядру разрешена.
+     */
+    bool isKernelOffloadEnabled() const { return kernelOffload; }
+
+private:
+    std::string certPath;       ///< Файл сертификата
+    std::string keyPath;        ///< Файл закрытого ключа
+    bool kernelOffload;         ///< Разрешен kTLS
+    SSL_CTX* context = nullptr; ///< Контекст OpenSSL
+};
+
+#endif // TLS_H
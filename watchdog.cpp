@@ -0,0 +1,160 @@
+/**
+ * @file watchdog.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация сторожа зависаний.
+ */
+
+#include "watchdog.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <execinfo.h>
+#include <unistd.h>
+
+/// Сигнал, по которому зависший поток пишет свой стек.
+static const int kTraceSignal = SIGUSR2;
+
+/// Глубина снимаемого стека.
+static const int kTraceFrames = 64;
+
+/// Дескриптор для стека (читается из обработчика сигнала).
+static std::atomic<int> traceDescriptor{-1};
+
+/**
+ * @brief Обработчик сигнала: пишет стек текущего потока.
+ * @details Использует только write(), backtrace() (заранее прогретый) и
+ *          backtrace_symbols_fd(), которые не выделяют память.
+ */
+static void dumpStack(int) {
+    int fd = traceDescriptor.load();
+    if (fd < 0) {
+        return;
+    }
+    static const char header[] = "--- stack of stalled thread ---\n";
+    ssize_t written = write(fd, header, sizeof(header) - 1);
+    (void)written;
+    void* frames[kTraceFrames];
+    int depth = backtrace(frames, kTraceFrames);
+    backtrace_symbols_fd(frames, depth, fd);
+}
+
+int64_t Watchdog::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t Heartbeat::finishUnit() {
+    int64_t now = Watchdog::nowNs();
+    int64_t since = sinceNs.load(std::memory_order_relaxed);
+    if (!waiting.load(std::memory_order_relaxed) && since != 0) {
+        metrics->loopLag.observe(static_cast<uint64_t>(now - since) / 1000);
+    }
+    return now;
+}
+
+void Heartbeat::beat(const char* currentStage, int currentConnection) {
+    int64_t now = finishUnit();
+    stage.store(currentStage, std::memory_order_relaxed);
+    connection.store(currentConnection, std::memory_order_relaxed);
+    sinceNs.store(now, std::memory_order_release);
+    waiting.store(false, std::memory_order_release);
+}
+
+void Heartbeat::idle() {
+    int64_t now = finishUnit();
+    sinceNs.store(now, std::memory_order_release);
+    waiting.store(true, std::memory_order_release);
+}
+
+Watchdog::Watchdog(ServerMetrics& metrics, int stallThresholdMs, std::function<void(const std::string&)> log,
+                   int traceFd)
+    : metrics(metrics), stallThresholdNs(static_cast<int64_t>(stallThresholdMs) * 1000000),
+      log(std::move(log)), traceFd(traceFd) {}
+
+Watchdog::~Watchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (traceFd >= 0) {
+        if (traceDescriptor.load() == traceFd) {
+            traceDescriptor = -1;
+        }
+        close(traceFd);
+    }
+}
+
+void Watchdog::start() {
+    if (traceFd >= 0) {
+        // Первый вызов backtrace() загружает libgcc: делаем его здесь, а не в обработчике
+        void* frames[1];
+        backtrace(frames, 1);
+        traceDescriptor = traceFd;
+
+        struct sigaction action {};
+        action.sa_handler = dumpStack;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(kTraceSignal, &action, nullptr);
+    }
+    thread = std::thread(&Watchdog::run, this);
+}
+
+Heartbeat* Watchdog::attach(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    heartbeats.emplace_back();
+    Heartbeat& heartbeat = heartbeats.back();
+    heartbeat.name = name;
+    heartbeat.thread = pthread_self();
+    heartbeat.metrics = &metrics;
+    heartbeat.waiting = true;
+    return &heartbeat;
+}
+
+void Watchdog::check(int64_t now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Heartbeat& heartbeat : heartbeats) {
+        bool waiting = heartbeat.waiting.load(std::memory_order_acquire);
+        int64_t since = heartbeat.sinceNs.load(std::memory_order_acquire);
+
+        // Цикл сменил единицу работы: зависание закончилось в момент нового пульса
+        if (heartbeat.stalled && (waiting || since != heartbeat.stalledSinceNs)) {
+            int64_t duration = since - heartbeat.stalledSinceNs;
+            metrics.stallDuration.observe(static_cast<uint64_t>(duration) / 1000);
+            log("Stall ended: " + heartbeat.name + " resumed after " + std::to_string(duration / 1000000) + " ms");
+            heartbeat.stalled = false;
+        }
+
+        if (!heartbeat.stalled && !waiting && since != 0 && now - since >= stallThresholdNs) {
+            heartbeat.stalled = true;
+            heartbeat.stalledSinceNs = since;
+            metrics.stalls++;
+            log("Stall detected: " + heartbeat.name + " busy for " + std::to_string((now - since) / 1000000) +
+                " ms in stage " + heartbeat.stage.load(std::memory_order_relaxed) + ", connection " +
+                std::to_string(heartbeat.connection.load(std::memory_order_relaxed)));
+            if (traceFd >= 0) {
+                pthread_kill(heartbeat.thread, kTraceSignal);
+            }
+        }
+    }
+}
+
+void Watchdog::run() {
+    std::chrono::milliseconds tick(std::clamp<int64_t>(stallThresholdNs / 4000000, 1, 100));
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, tick);
+        if (stopping) {
+            break;
+        }
+        lock.unlock();
+        check(nowNs());
+        lock.lock();
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * @file watchdog.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл сторожа зависаний циклов обработки.
+ * @details Каждый цикл (последовательный цикл accept или событийный цикл)
+ *          обновляет свой пульс после каждой единицы работы: этап и
+ *          подключение. Длительность единиц работы попадает в гистограмму
+ *          задержек цикла. Отдельный поток сторожа проверяет пульсы; если
+ *          цикл занят одной единицей работы дольше порога, сторож пишет в
+ *          лог этап и подключение, снимает стек зависшего потока сигналом
+ *          и после выхода из зависания учитывает его длительность.
+ */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <pthread.h>
+
+struct ServerMetrics;
+
+/**
+ * @brief Пульс одного цикла обработки.
+ * @details Обновляется только своим потоком; сторож лишь читает поля.
+ */
+class Heartbeat {
+public:
+    /**
+     * @brief Отмечает начало новой единицы работы.
+     * @param stage Этап (строковый литерал: указатель хранится без копирования).
+     * @param connection Сокет подключения (-1 — нет).
+     */
+    void beat(const char* stage, int connection);
+
+    /**
+     * @brief Отмечает переход к ожиданию (accept(), epoll_wait()).
+     * @details Ожидание событий зависанием не считается.
+     */
+    void idle();
+
+private:
+    friend class Watchdog;
+
+    std::string name;                          ///< Имя цикла для лога
+    pthread_t thread;                          ///< Поток цикла
+    ServerMetrics* metrics = nullptr;          ///< Гистограмма задержек цикла
+    std::atomic<int64_t> sinceNs{0};           ///< Начало текущей единицы работы
+    std::atomic<const char*> stage{"start"};   ///< Текущий этап
+    std::atomic<int> connection{-1};           ///< Текущее подключение
+    std::atomic<bool> waiting{false};          ///< Цикл ждет событий
+
+    // Состояние сторожа (только поток сторожа)
+    bool stalled = false;                      ///< Зависание уже обнаружено
+    int64_t stalledSinceNs = 0;                ///< Начало зависшей единицы работы
+
+    /**
+     * @brief Завершает текущую единицу работы и учитывает ее длительность.
+     * @return Текущее время, нс.
+     */
+    int64_t finishUnit();
+};
+
+/**
+ * @brief Сторож зависаний.
+ */
+class Watchdog {
+public:
+    /**
+     * @brief Конструктор сторожа.
+     * @param metrics Счетчики сервера (гистограммы и число зависаний).
+     * @param stallThresholdMs Порог зависания, мс.
+     * @param log Запись сообщения в лог сервера.
+     * @param traceFd Дескриптор, в который пишется стек зависшего потока
+     *                (-1 — не снимать); закрывается сторожем.
+     */
+    Watchdog(ServerMetrics& metrics, int stallThresholdMs, std::function<void(const std::string&)> log,
+             int traceFd);
+
+    /**
+     * @brief Деструктор: останавливает поток сторожа и закрывает traceFd.
+     */
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    /**
+     * @brief Запускает поток сторожа и ставит обработчик сигнала снятия стека.
+     */
+    void start();
+
+    /**
+     * @brief Регистрирует цикл вызывающего потока.
+     * @param name Имя цикла для лога.
+     * @return Пульс (живет, пока жив сторож).
+     */
+    Heartbeat* attach(const std::string& name);
+
+    /**
+     * @brief Проверяет пульсы один раз (вызывается потоком сторожа).
+     * @param now Текущее время steady_clock, нс.
+     */
+    void check(int64_t now);
+
+    /**
+     * @brief Возвращает монотонное время в наносекундах.
+     */
+    static int64_t nowNs();
+
+private:
+    ServerMetrics& metrics;                           ///< Счетчики сервера
+    int64_t stallThresholdNs;                         ///< Порог зависания, нс
+    std::function<void(const std::string&)> log;      ///< Запись в лог
+    int traceFd;                                      ///< Куда писать стек
+    std::mutex mutex;                                 ///< Защищает heartbeats и stopping
+    std::condition_variable wake;                     ///< Остановка сторожа
+    std::deque<Heartbeat> heartbeats;                 ///< Пульсы (адреса не меняются)
+    bool stopping = false;                            ///< Запрошена остановка
+    std::thread thread;                               ///< Поток сторожа
+
+    /**
+     * @brief Основной цикл потока сторожа.
+     */
+    void run();
+};
+
+#endif // WATCHDOG_H
@@ -0,0 +1,118 @@
+/**
+ * @file workerpool.cpp
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Реализация пула событийных циклов с балансировкой нагрузки.
+ */
+
+#include "workerpool.h"
+#include "server.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <pthread.h>
+
+WorkerPool::WorkerPool(Server& server, int listenSocket, size_t workers, int rebalanceIntervalMs)
+    : rebalanceIntervalMs(rebalanceIntervalMs) {
+    for (size_t i = 0; i < workers; ++i) {
+        loops.emplace_back(new EventLoop(server, i == 0 ? listenSocket : -1));
+    }
+    std::vector<EventLoop*> peers;
+    for (auto& loop : loops) {
+        peers.push_back(loop.get());
+    }
+    loops[0]->setPeers(peers);
+}
+
+MigrationPlan WorkerPool::plan(const std::vector<WorkerSample>& samples) {
+    MigrationPlan result;
+    if (samples.size() < 2) {
+        return result;
+    }
+    for (size_t i = 1; i < samples.size(); ++i) {
+        if (samples[i].utilisation > samples[result.from].utilisation) {
+            result.from = i;
+        }
+        if (samples[i].utilisation < samples[result.to].utilisation) {
+            result.to = i;
+        }
+    }
+
+    const WorkerSample& hot = samples[result.from];
+    const WorkerSample& cold = samples[result.to];
+    double gap = hot.utilisation - cold.utilisation;
+    if (gap < kRebalanceThreshold || hot.sessions < 2) {
+        return result;
+    }
+    // Нагрузку создают активные подключения (в среднем queueDepth за пробуждение);
+    // переносим их долю, которая делит разницу пополам. Цикл отдает подключения
+    // между пакетами: сначала простаивающие, затем активные по мере завершения пакетов
+    double share = gap / (2.0 * hot.utilisation);
+    uint32_t count = static_cast<uint32_t>(std::lround(hot.queueDepth * share));
+    result.count = std::min<uint32_t>(std::max<uint32_t>(count, 1), hot.sessions - 1);
+    return result;
+}
+
+bool WorkerPool::run() {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < loops.size(); ++i) {
+        EventLoop* loop = loops[i].get();
+        std::string name = "worker-" + std::to_string(i);
+        loop->setName(name);
+        threads.emplace_back([this, loop] {
+            if (!loop->run()) {
+                failed = true;
+            }
+        });
+        pthread_setname_np(threads.back().native_handle(), name.c_str());
+    }
+
+    std::vector<uint64_t> lastBusy(loops.size(), 0);
+    std::vector<uint64_t> lastReady(loops.size(), 0);
+    std::vector<uint64_t> lastWakeups(loops.size(), 0);
+    std::chrono::steady_clock::time_point lastSample = std::chrono::steady_clock::now();
+    int period = rebalanceIntervalMs > 0 ? rebalanceIntervalMs : 1000;
+    while (!failed) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(period));
+        if (rebalanceIntervalMs <= 0) {
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double intervalNs = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastSample).count());
+        lastSample = now;
+
+        std::vector<WorkerSample> samples;
+        for (size_t i = 0; i < loops.size(); ++i) {
+            const WorkerLoad& load = loops[i]->getLoad();
+            uint64_t busy = load.busyNs.load(std::memory_order_relaxed);
+            uint64_t ready = load.readyEvents.load(std::memory_order_relaxed);
+            uint64_t wakeups = load.wakeups.load(std::memory_order_relaxed);
+            double depth = wakeups > lastWakeups[i]
+                ? static_cast<double>(ready - lastReady[i]) / static_cast<double>(wakeups - lastWakeups[i]) : 0.0;
+            samples.push_back({static_cast<double>(busy - lastBusy[i]) / intervalNs, depth,
+                               load.sessions.load(std::memory_order_relaxed)});
+            lastBusy[i] = busy;
+            lastReady[i] = ready;
+            lastWakeups[i] = wakeups;
+        }
+
+        MigrationPlan migration = plan(samples);
+        if (migration.count > 0) {
+            loops[migration.from]->requestMigration(loops[migration.to].get(), migration.count);
+        }
+    }
+
+    // Циклы не завершаются сами: ошибка одного останавливает сервер целиком.
+    // Остальные потоки доживают до выхода процесса, поэтому их циклы не освобождаются
+    for (auto& thread : threads) {
+        thread.detach();
+    }
+    for (auto& loop : loops) {
+        loop.release();
+    }
+    return false;
+}
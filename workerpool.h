@@ -0,0 +1,84 @@
+/**
+ * @file workerpool.h
+ * @author Чернышев Ринат Рустямович
+ * @date 26.12.2025
+ * @brief Заголовочный файл пула событийных циклов с балансировкой нагрузки.
+ * @details Каждый поток-обработчик ведет свой цикл epoll. Принятые
+ *          подключения раздаются циклам по кругу, а балансировщик
+ *          периодически сравнивает загрузку циклов и переносит подключения
+ *          (сокет вместе с состоянием Session) с загруженного цикла на
+ *          свободный через очереди передачи без блокировок.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "eventloop.h"
+
+class Server;
+
+/// Разница загрузки циклов (доля времени), при которой начинается перенос.
+static const double kRebalanceThreshold = 0.15;
+
+/**
+ * @brief Загрузка цикла за интервал балансировки.
+ */
+struct WorkerSample {
+    double utilisation;  ///< Доля интервала, занятая обработкой событий
+    double queueDepth;   ///< Среднее число готовых событий за пробуждение
+    uint32_t sessions;   ///< Открытые подключения
+};
+
+/**
+ * @brief Решение балансировщика.
+ */
+struct MigrationPlan {
+    size_t from = 0;     ///< Загруженный цикл
+    size_t to = 0;       ///< Свободный цикл
+    uint32_t count = 0;  ///< Сколько подключений перенести (0 — ничего не делать)
+};
+
+/**
+ * @brief Пул событийных циклов.
+ */
+class WorkerPool {
+public:
+    /**
+     * @brief Конструктор пула.
+     * @param server Сервер.
+     * @param listenSocket Слушающий сокет (принимает первый цикл).
+     * @param workers Количество циклов (потоков).
+     * @param rebalanceIntervalMs Период балансировки, мс (0 — без балансировки).
+     */
+    WorkerPool(Server& server, int listenSocket, size_t workers, int rebalanceIntervalMs);
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Запускает циклы в потоках и балансировщик в текущем потоке.
+     * @return false если какой-либо цикл не запустился.
+     */
+    bool run();
+
+    /**
+     * @brief Выбирает перенос подключений по загрузке циклов.
+     * @param samples Загрузка каждого цикла за последний интервал.
+     * @return План переноса: с самого загруженного цикла на самый свободный
+     *         переносится доля активных подключений (глубина очереди
+     *         событий), выравнивающая их загрузку.
+     */
+    static MigrationPlan plan(const std::vector<WorkerSample>& samples);
+
+private:
+    int rebalanceIntervalMs;                        ///< Период балансировки, мс
+    std::vector<std::unique_ptr<EventLoop>> loops;  ///< Циклы пула
+    std::atomic<bool> failed{false};                ///< Цикл завершился с ошибкой
+};
+
+#endif // WORKERPOOL_H